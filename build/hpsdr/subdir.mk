@@ -5,39 +5,90 @@
 # Add inputs and outputs from these tool invocations to the build variables 
 C_SRCS += \
 ../hpsdr/hpsdr_config.c \
+../hpsdr/hpsdr_control.c \
+../hpsdr/hpsdr_convert.c \
 ../hpsdr/hpsdr_debug.c \
+../hpsdr/hpsdr_dma.c \
+../hpsdr/hpsdr_dma_virtual.c \
 ../hpsdr/hpsdr_ep2.c \
 ../hpsdr/hpsdr_ep6.c \
 ../hpsdr/hpsdr_filters.c \
+../hpsdr/hpsdr_flow.c \
 ../hpsdr/hpsdr_functions.c \
+../hpsdr/hpsdr_interp.c \
 ../hpsdr/hpsdr_iq_tx.c \
+../hpsdr/hpsdr_jitter.c \
 ../hpsdr/hpsdr_main.c \
 ../hpsdr/hpsdr_network.c \
-../hpsdr/hpsdr_tx_samples.c 
+../hpsdr/hpsdr_pack.c \
+../hpsdr/hpsdr_pipeline.c \
+../hpsdr/hpsdr_pool.c \
+../hpsdr/hpsdr_queue.c \
+../hpsdr/hpsdr_resample.c \
+../hpsdr/hpsdr_ring.c \
+../hpsdr/hpsdr_rx.c \
+../hpsdr/hpsdr_rx_file.c \
+../hpsdr/hpsdr_stats.c \
+../hpsdr/hpsdr_tx_samples.c \
+../hpsdr/hpsdr_uring.c 
 
 OBJS += \
 ./hpsdr/hpsdr_config.o \
+./hpsdr/hpsdr_control.o \
+./hpsdr/hpsdr_convert.o \
 ./hpsdr/hpsdr_debug.o \
+./hpsdr/hpsdr_dma.o \
+./hpsdr/hpsdr_dma_virtual.o \
 ./hpsdr/hpsdr_ep2.o \
 ./hpsdr/hpsdr_ep6.o \
 ./hpsdr/hpsdr_filters.o \
+./hpsdr/hpsdr_flow.o \
 ./hpsdr/hpsdr_functions.o \
+./hpsdr/hpsdr_interp.o \
 ./hpsdr/hpsdr_iq_tx.o \
+./hpsdr/hpsdr_jitter.o \
 ./hpsdr/hpsdr_main.o \
 ./hpsdr/hpsdr_network.o \
-./hpsdr/hpsdr_tx_samples.o 
+./hpsdr/hpsdr_pack.o \
+./hpsdr/hpsdr_pipeline.o \
+./hpsdr/hpsdr_pool.o \
+./hpsdr/hpsdr_queue.o \
+./hpsdr/hpsdr_resample.o \
+./hpsdr/hpsdr_ring.o \
+./hpsdr/hpsdr_rx.o \
+./hpsdr/hpsdr_rx_file.o \
+./hpsdr/hpsdr_stats.o \
+./hpsdr/hpsdr_tx_samples.o \
+./hpsdr/hpsdr_uring.o 
 
 C_DEPS += \
 ./hpsdr/hpsdr_config.d \
+./hpsdr/hpsdr_control.d \
+./hpsdr/hpsdr_convert.d \
 ./hpsdr/hpsdr_debug.d \
+./hpsdr/hpsdr_dma.d \
+./hpsdr/hpsdr_dma_virtual.d \
 ./hpsdr/hpsdr_ep2.d \
 ./hpsdr/hpsdr_ep6.d \
 ./hpsdr/hpsdr_filters.d \
+./hpsdr/hpsdr_flow.d \
 ./hpsdr/hpsdr_functions.d \
+./hpsdr/hpsdr_interp.d \
 ./hpsdr/hpsdr_iq_tx.d \
+./hpsdr/hpsdr_jitter.d \
 ./hpsdr/hpsdr_main.d \
 ./hpsdr/hpsdr_network.d \
-./hpsdr/hpsdr_tx_samples.d 
+./hpsdr/hpsdr_pack.d \
+./hpsdr/hpsdr_pipeline.d \
+./hpsdr/hpsdr_pool.d \
+./hpsdr/hpsdr_queue.d \
+./hpsdr/hpsdr_resample.d \
+./hpsdr/hpsdr_ring.d \
+./hpsdr/hpsdr_rx.d \
+./hpsdr/hpsdr_rx_file.d \
+./hpsdr/hpsdr_stats.d \
+./hpsdr/hpsdr_tx_samples.d \
+./hpsdr/hpsdr_uring.d 
 
 
 # Each subdirectory must supply rules for building sources it contributes
@@ -40,6 +40,7 @@
 #include "hpsdr_definitions.h"
 #include "hpsdr_main.h"
 #include "hpsdr_debug.h"
+#include "hpsdr_pipeline.h"
 
 static int emu;
 static char default_cfg[] = ""
@@ -48,8 +49,49 @@ static char default_cfg[] = ""
         "        <debug>     true       </debug>\n"
         "        <iqburst>   1000       </iqburst>\n"
         "        <emulation> hermeslite </emulation>\n"
+        "        <rxbatch>   8          </rxbatch>\n"
+        "        <rxgro>     false      </rxgro>\n"
+        "        <txbatch>   1          </txbatch>\n"
+        "        <txgso>     true       </txgso>\n"
+        "        <statsinterval> 0      </statsinterval>\n"
+        "        <netbackend> socket    </netbackend>\n"
+        "        <pktpool>   128        </pktpool>\n"
+        "        <runmode>   threaded   </runmode>\n"
+        "        <reorder>   4          </reorder>\n"
+        "        <catchup>   burst      </catchup>\n"
+        "        <flowcontrol> false    </flowcontrol>\n"
+        "        <flowppm>   10         </flowppm>\n"
+        "        <bench>     false      </bench>\n"
         "    </global>\n"
         "\n"
+        "    <pipeline>\n"
+        "        <enabled>   false      </enabled>\n"
+        "        <queue>     256        </queue>\n"
+        "        <netcpu>    -1         </netcpu>\n"
+        "        <decodecpu> -1         </decodecpu>\n"
+        "        <txcpu>     -1         </txcpu>\n"
+        "        <ep6cpu>    -1         </ep6cpu>\n"
+        "    </pipeline>\n"
+        "\n"
+        "    <tx>\n"
+        "        <retunewindow> 10000   </retunewindow>\n"
+        "        <compact>   false      </compact>\n"
+        "        <jitterbuffer> false   </jitterbuffer>\n"
+        "        <jitterpercentile> 95  </jitterpercentile>\n"
+        "        <jittermax> 100        </jittermax>\n"
+        "        <resample>  false      </resample>\n"
+        "        <interpolation> 1      </interpolation>\n"
+        "        <taps>      16         </taps>\n"
+        "        <dma>       rpitx      </dma>\n"
+        "        <dmappm>    0          </dmappm>\n"
+        "    </tx>\n"
+        "\n"
+        "    <rx>\n"
+        "        <source>    none       </source>\n"
+        "        <format>    s16        </format>\n"
+        "        <channels>  2          </channels>\n"
+        "    </rx>\n"
+        "\n"
         "    <filters>\n"
         "        <enabled> false </enabled>\n"
         "        <delay>   1     </delay>\n"
@@ -212,6 +254,109 @@ static char *filter_type[4] = {
         "mcp23016" //
         };
 
+static char *net_backend[2] = {
+        "socket",  //
+        "iouring"  //
+        };
+
+static int get_net_backend(char *name) {
+    int n;
+    for (int i = 0; i < strlen(name); i++)
+        name[i] = tolower(name[i]);
+    for (n = 0; n < 2; n++) {
+        if (strcmp(name, net_backend[n]) == 0) {
+            return n;
+        }
+    }
+    return -1;
+}
+
+static char *dma_backend[2] = {
+        "rpitx",   //
+        "virtual"  //
+        };
+
+static int get_dma_backend(char *name) {
+    int n;
+    for (int i = 0; i < strlen(name); i++)
+        name[i] = tolower(name[i]);
+    for (n = 0; n < 2; n++) {
+        if (strcmp(name, dma_backend[n]) == 0) {
+            return n;
+        }
+    }
+    return -1;
+}
+
+static char *rx_source[2] = {
+        "none",  //
+        "file"   //
+        };
+
+static int get_rx_source(char *name) {
+    int n;
+    for (int i = 0; i < strlen(name); i++)
+        name[i] = tolower(name[i]);
+    for (n = 0; n < 2; n++) {
+        if (strcmp(name, rx_source[n]) == 0) {
+            return n;
+        }
+    }
+    return -1;
+}
+
+static char *rx_format[3] = {
+        "s16", //
+        "s24", //
+        "f32"  //
+        };
+
+static int get_rx_format(char *name) {
+    int n;
+    for (int i = 0; i < strlen(name); i++)
+        name[i] = tolower(name[i]);
+    for (n = 0; n < 3; n++) {
+        if (strcmp(name, rx_format[n]) == 0) {
+            return n;
+        }
+    }
+    return -1;
+}
+
+static char *run_mode[2] = {
+        "threaded", //
+        "single"    //
+        };
+
+static int get_run_mode(char *name) {
+    int n;
+    for (int i = 0; i < strlen(name); i++)
+        name[i] = tolower(name[i]);
+    for (n = 0; n < 2; n++) {
+        if (strcmp(name, run_mode[n]) == 0) {
+            return n;
+        }
+    }
+    return -1;
+}
+
+static char *catchup[2] = {
+        "burst", //
+        "skip"   //
+        };
+
+static int get_catchup(char *name) {
+    int n;
+    for (int i = 0; i < strlen(name); i++)
+        name[i] = tolower(name[i]);
+    for (n = 0; n < 2; n++) {
+        if (strcmp(name, catchup[n]) == 0) {
+            return n;
+        }
+    }
+    return -1;
+}
+
 static int get_device(char *name) {
     int n;
     for (int i = 0; i < strlen(name); i++)
@@ -304,6 +449,42 @@ static void print_config(hpsdr_config_t config) {
     hpsdr_dbg_printf(0, "    config.global.debug = %s\n", config.global.debug ? "true" : "false");
     hpsdr_dbg_printf(0, "  config.global.iqburst = %d\n", config.global.iqburst);
     hpsdr_dbg_printf(0, "config.global.emulation = %s\n", device_type[emu]);
+    hpsdr_dbg_printf(0, "  config.global.rxbatch = %d\n", config.global.rxbatch);
+    hpsdr_dbg_printf(0, "    config.global.rxgro = %s\n", config.global.rxgro ? "true" : "false");
+    hpsdr_dbg_printf(0, "  config.global.txbatch = %d\n", config.global.txbatch);
+    hpsdr_dbg_printf(0, "    config.global.txgso = %s\n", config.global.txgso ? "true" : "false");
+    hpsdr_dbg_printf(0, "config.global.statsinterval = %d s\n", config.global.statsinterval);
+    hpsdr_dbg_printf(0, "config.global.netbackend = %s\n", net_backend[config.global.netbackend]);
+    hpsdr_dbg_printf(0, "  config.global.pktpool = %d\n", config.global.pktpool);
+    hpsdr_dbg_printf(0, "  config.global.runmode = %s\n", run_mode[config.global.runmode]);
+    hpsdr_dbg_printf(0, "  config.global.reorder = %d\n", config.global.reorder);
+    hpsdr_dbg_printf(0, "  config.global.catchup = %s\n", catchup[config.global.catchup]);
+    hpsdr_dbg_printf(0, "config.global.flowcontrol = %s\n", config.global.flowcontrol ? "true" : "false");
+    hpsdr_dbg_printf(0, "  config.global.flowppm = %d ppm\n", config.global.flowppm);
+    hpsdr_dbg_printf(0, "    config.global.bench = %s\n", config.global.bench ? "true" : "false");
+    hpsdr_dbg_printf(0, "----------------------- pipeline ------------------------\n");
+    hpsdr_dbg_printf(0, "config.pipeline.enabled = %s\n", config.pipeline.enabled ? "true" : "false");
+    hpsdr_dbg_printf(0, "  config.pipeline.queue = %d\n", config.pipeline.queue);
+    hpsdr_dbg_printf(0, " config.pipeline.netcpu = %d\n", config.pipeline.cpu[0]);
+    hpsdr_dbg_printf(0, "config.pipeline.decodecpu = %d\n", config.pipeline.cpu[1]);
+    hpsdr_dbg_printf(0, "  config.pipeline.txcpu = %d\n", config.pipeline.cpu[2]);
+    hpsdr_dbg_printf(0, " config.pipeline.ep6cpu = %d\n", config.pipeline.cpu[3]);
+    hpsdr_dbg_printf(0, "----------------------- tx ------------------------------\n");
+    hpsdr_dbg_printf(0, "config.tx.retunewindow = %d Hz\n", config.tx.retunewindow);
+    hpsdr_dbg_printf(0, "     config.tx.compact = %s\n", config.tx.compact ? "true" : "false");
+    hpsdr_dbg_printf(0, "config.tx.jitterbuffer = %s\n", config.tx.jitterbuffer ? "true" : "false");
+    hpsdr_dbg_printf(0, "config.tx.jitterpercentile = %d\n", config.tx.jitterpercentile);
+    hpsdr_dbg_printf(0, "   config.tx.jittermax = %d ms\n", config.tx.jittermax);
+    hpsdr_dbg_printf(0, "    config.tx.resample = %s\n", config.tx.resample ? "true" : "false");
+    hpsdr_dbg_printf(0, "config.tx.interpolation = %d\n", config.tx.interpolation);
+    hpsdr_dbg_printf(0, "        config.tx.taps = %d\n", config.tx.taps);
+    hpsdr_dbg_printf(0, "         config.tx.dma = %s\n", dma_backend[config.tx.dma]);
+    hpsdr_dbg_printf(0, "     config.tx.dmafile = %s\n", config.tx.dmafile == NULL ? "(none)" : config.tx.dmafile);
+    hpsdr_dbg_printf(0, "      config.tx.dmappm = %d\n", config.tx.dmappm);
+    hpsdr_dbg_printf(0, "      config.rx.source = %s\n", rx_source[config.rx.source]);
+    hpsdr_dbg_printf(0, "        config.rx.file = %s\n", config.rx.file == NULL ? "(none)" : config.rx.file);
+    hpsdr_dbg_printf(0, "      config.rx.format = %s\n", rx_format[config.rx.format]);
+    hpsdr_dbg_printf(0, "    config.rx.channels = %d\n", config.rx.channels);
     hpsdr_dbg_printf(0, "----------------------- filters -------------------------\n");
     hpsdr_dbg_printf(0, " config.filters.enabled = %s\n", config.filters.enabled ? "true" : "false");
     hpsdr_dbg_printf(0, "   config.filters.delay = %d\n", config.filters.delay);
@@ -330,6 +511,8 @@ static void print_config(hpsdr_config_t config) {
 		                            if (err != 0) { \
 		                                hpsdr_dbg_printf(0, "ERROR:"); hpsdr_dbg_printf(0, str); hpsdr_dbg_printf(0, "= %s\n", GET_STR(db, str)); return 1;} \
 		                            out = res; }
+#define GET_INT_OPT(out, db, str, def)  { if (mxml_exists(db, str)) GET_INT(out, db, str) else out = def; }
+#define GET_BOOL_OPT(out, db, str, def) { if (mxml_exists(db, str)) GET_BOOL(out, db, str) else out = def; }
 
 int hpsdr_config_init(char *filename) {
     char *node, tmp[1024];
@@ -364,6 +547,164 @@ int hpsdr_config_init(char *filename) {
         return 1;
     }
     config.global.emulation = devices_id[emu];
+    GET_INT_OPT(config.global.rxbatch, db, "config.global.rxbatch", 8);
+    if (config.global.rxbatch < 1 || config.global.rxbatch > 64) {
+        hpsdr_dbg_printf(0, "ERROR: config.global.rxbatch = %d (allowed: 1 - 64)\n", config.global.rxbatch);
+        return 1;
+    }
+    GET_BOOL_OPT(config.global.rxgro, db, "config.global.rxgro", false);
+    GET_INT_OPT(config.global.txbatch, db, "config.global.txbatch", 1);
+    if (config.global.txbatch < 1 || config.global.txbatch > 32) {
+        hpsdr_dbg_printf(0, "ERROR: config.global.txbatch = %d (allowed: 1 - 32)\n", config.global.txbatch);
+        return 1;
+    }
+    GET_BOOL_OPT(config.global.txgso, db, "config.global.txgso", true);
+    GET_INT_OPT(config.global.statsinterval, db, "config.global.statsinterval", 0);
+    config.global.netbackend = NET_SOCKET;
+    if (mxml_exists(db, "config.global.netbackend")) {
+        int backend = get_net_backend(GET_STR(db, "config.global.netbackend"));
+        if (backend == -1) {
+            hpsdr_dbg_printf(0, "ERROR: config.global.netbackend = %s\n", GET_STR(db, "config.global.netbackend"));
+            return 1;
+        }
+        config.global.netbackend = backend;
+    }
+    GET_INT_OPT(config.global.pktpool, db, "config.global.pktpool", 128);
+    if (config.global.pktpool < 16 || config.global.pktpool > 4096) {
+        hpsdr_dbg_printf(0, "ERROR: config.global.pktpool = %d (allowed: 16 - 4096)\n", config.global.pktpool);
+        return 1;
+    }
+    config.global.runmode = RUN_THREADED;
+    if (mxml_exists(db, "config.global.runmode")) {
+        int mode = get_run_mode(GET_STR(db, "config.global.runmode"));
+        if (mode == -1) {
+            hpsdr_dbg_printf(0, "ERROR: config.global.runmode = %s\n", GET_STR(db, "config.global.runmode"));
+            return 1;
+        }
+        config.global.runmode = mode;
+    }
+    GET_INT_OPT(config.global.reorder, db, "config.global.reorder", 4);
+    if (config.global.reorder < 0 || config.global.reorder > REORDER_MAX) {
+        hpsdr_dbg_printf(0, "ERROR: config.global.reorder = %d (allowed: 0 - %d)\n", config.global.reorder, REORDER_MAX);
+        return 1;
+    }
+    config.global.catchup = CATCHUP_BURST;
+    if (mxml_exists(db, "config.global.catchup")) {
+        int mode = get_catchup(GET_STR(db, "config.global.catchup"));
+        if (mode == -1) {
+            hpsdr_dbg_printf(0, "ERROR: config.global.catchup = %s (allowed: burst, skip)\n", GET_STR(db, "config.global.catchup"));
+            return 1;
+        }
+        config.global.catchup = mode;
+    }
+    GET_BOOL_OPT(config.global.flowcontrol, db, "config.global.flowcontrol", false);
+    GET_INT_OPT(config.global.flowppm, db, "config.global.flowppm", 10);
+    if (config.global.flowppm < 1 || config.global.flowppm > 100) {
+        hpsdr_dbg_printf(0, "ERROR: config.global.flowppm = %d (allowed: 1 - 100)\n", config.global.flowppm);
+        return 1;
+    }
+    GET_BOOL_OPT(config.global.bench, db, "config.global.bench", false);
+
+    // pipeline
+    hpsdr_dbg_printf(0, "reading pipeline\n");
+    GET_BOOL_OPT(config.pipeline.enabled, db, "config.pipeline.enabled", false);
+    GET_INT_OPT(config.pipeline.queue, db, "config.pipeline.queue", 256);
+    if (config.pipeline.queue < 8 || config.pipeline.queue > 4096) {
+        hpsdr_dbg_printf(0, "ERROR: config.pipeline.queue = %d (allowed: 8 - 4096)\n", config.pipeline.queue);
+        return 1;
+    }
+    GET_INT_OPT(config.pipeline.cpu[0], db, "config.pipeline.netcpu", -1);
+    GET_INT_OPT(config.pipeline.cpu[1], db, "config.pipeline.decodecpu", -1);
+    GET_INT_OPT(config.pipeline.cpu[2], db, "config.pipeline.txcpu", -1);
+    GET_INT_OPT(config.pipeline.cpu[3], db, "config.pipeline.ep6cpu", -1);
+    if (config.global.runmode == RUN_SINGLE && config.pipeline.enabled) {
+        hpsdr_dbg_printf(0, "WARNING: config.pipeline.enabled ignored in single run mode\n");
+        config.pipeline.enabled = false;
+    }
+
+    // tx
+    hpsdr_dbg_printf(0, "reading tx\n");
+    GET_INT_OPT(config.tx.retunewindow, db, "config.tx.retunewindow", 10000);
+    if (config.tx.retunewindow < 0 || config.tx.retunewindow > 20000) {
+        hpsdr_dbg_printf(0, "ERROR: config.tx.retunewindow = %d (allowed: 0 - 20000)\n", config.tx.retunewindow);
+        return 1;
+    }
+    GET_BOOL_OPT(config.tx.compact, db, "config.tx.compact", false);
+    GET_BOOL_OPT(config.tx.jitterbuffer, db, "config.tx.jitterbuffer", false);
+    GET_INT_OPT(config.tx.jitterpercentile, db, "config.tx.jitterpercentile", 95);
+    if (config.tx.jitterpercentile < 50 || config.tx.jitterpercentile > 100) {
+        hpsdr_dbg_printf(0, "ERROR: config.tx.jitterpercentile = %d (allowed: 50 - 100)\n", config.tx.jitterpercentile);
+        return 1;
+    }
+    GET_INT_OPT(config.tx.jittermax, db, "config.tx.jittermax", 100);
+    if (config.tx.jittermax < 1 || config.tx.jittermax > 250) {
+        hpsdr_dbg_printf(0, "ERROR: config.tx.jittermax = %d (allowed: 1 - 250)\n", config.tx.jittermax);
+        return 1;
+    }
+    GET_BOOL_OPT(config.tx.resample, db, "config.tx.resample", false);
+    if (config.global.flowcontrol && config.tx.resample) {
+        hpsdr_dbg_printf(0, "WARNING: config.tx.resample ignored with config.global.flowcontrol (both steer the tx fill)\n");
+        config.tx.resample = false;
+    }
+    GET_INT_OPT(config.tx.interpolation, db, "config.tx.interpolation", 1);
+    if (config.tx.interpolation != 1 && config.tx.interpolation != 2 && config.tx.interpolation != 4 && config.tx.interpolation != 8) {
+        hpsdr_dbg_printf(0, "ERROR: config.tx.interpolation = %d (allowed: 1, 2, 4, 8)\n", config.tx.interpolation);
+        return 1;
+    }
+    GET_INT_OPT(config.tx.taps, db, "config.tx.taps", 16);
+    if (config.tx.taps < 4 || config.tx.taps > 64) {
+        hpsdr_dbg_printf(0, "ERROR: config.tx.taps = %d (allowed: 4 - 64)\n", config.tx.taps);
+        return 1;
+    }
+    config.tx.dma = DMA_RPITX;
+    if (mxml_exists(db, "config.tx.dma")) {
+        int backend = get_dma_backend(GET_STR(db, "config.tx.dma"));
+        if (backend == -1) {
+            hpsdr_dbg_printf(0, "ERROR: config.tx.dma = %s (allowed: rpitx, virtual)\n", GET_STR(db, "config.tx.dma"));
+            return 1;
+        }
+        config.tx.dma = backend;
+    }
+    config.tx.dmafile = NULL;
+    if (mxml_exists(db, "config.tx.dmafile") && strlen(GET_STR(db, "config.tx.dmafile")) > 0)
+        config.tx.dmafile = strdup(GET_STR(db, "config.tx.dmafile"));
+    GET_INT_OPT(config.tx.dmappm, db, "config.tx.dmappm", 0);
+    if (config.tx.dmappm < -1000 || config.tx.dmappm > 1000) {
+        hpsdr_dbg_printf(0, "ERROR: config.tx.dmappm = %d (allowed: -1000 - 1000)\n", config.tx.dmappm);
+        return 1;
+    }
+
+    // rx
+    config.rx.source = RX_NONE;
+    if (mxml_exists(db, "config.rx.source")) {
+        int source = get_rx_source(GET_STR(db, "config.rx.source"));
+        if (source == -1) {
+            hpsdr_dbg_printf(0, "ERROR: config.rx.source = %s (allowed: none, file)\n", GET_STR(db, "config.rx.source"));
+            return 1;
+        }
+        config.rx.source = source;
+    }
+    config.rx.file = NULL;
+    if (mxml_exists(db, "config.rx.file") && strlen(GET_STR(db, "config.rx.file")) > 0)
+        config.rx.file = strdup(GET_STR(db, "config.rx.file"));
+    if (config.rx.source == RX_FILE && config.rx.file == NULL) {
+        hpsdr_dbg_printf(0, "ERROR: config.rx.source = file needs config.rx.file\n");
+        return 1;
+    }
+    config.rx.format = RX_S16;
+    if (mxml_exists(db, "config.rx.format")) {
+        int format = get_rx_format(GET_STR(db, "config.rx.format"));
+        if (format == -1) {
+            hpsdr_dbg_printf(0, "ERROR: config.rx.format = %s (allowed: s16, s24, f32)\n", GET_STR(db, "config.rx.format"));
+            return 1;
+        }
+        config.rx.format = format;
+    }
+    GET_INT_OPT(config.rx.channels, db, "config.rx.channels", 2);
+    if (config.rx.channels < 2 || config.rx.channels > 14 || config.rx.channels % 2) {
+        hpsdr_dbg_printf(0, "ERROR: config.rx.channels = %d (allowed: 2, 4, ... 14)\n", config.rx.channels);
+        return 1;
+    }
 
     // filters
     hpsdr_dbg_printf(0, "reading filters\n");
@@ -0,0 +1,158 @@
+/*
+ * Copyright 2021 Emiliano Gonzalez LU3VEA (lu3vea @ gmail . com))
+ * * Project Site: https://github.com/hiperiondev/hpsdr-p1-rpitx *
+ *
+ * This is based on other projects:
+ *    librpitx (https://github.com/F5OEO/librpitx)
+ *    HPSDR simulator (https://github.com/g0orx/pihpsdr)
+ *    small-memory XML config database library (https://github.com/dleonard0/mxml)
+ *
+ *    please contact their authors for more information.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ *
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "hpsdr_debug.h"
+#include "hpsdr_functions.h"
+#include "hpsdr_iq_tx.h"
+#include "hpsdr_network.h"
+#include "hpsdr_pipeline.h"
+#include "hpsdr_futex.h"
+#include "hpsdr_queue.h"
+#include "hpsdr_control.h"
+
+#define CTL_QUEUE 16
+
+typedef struct hpsdr_ctl_cmd {
+    hpsdr_ctl_type_t type;
+    struct sockaddr_in to;
+    uint8_t data[63];
+} hpsdr_ctl_cmd_t;
+
+static hpsdr_queue_t ctl_queue;  // commands, from the network thread only
+static uint32_t ctl_retune = 0;  // a tx frequency change is pending
+static uint32_t ctl_seq = 0;     // bumped on every request, the worker sleeps on it
+static bool ctl_run = false;
+static pthread_t ctl_id;
+
+hpsdr_control_stats_t ctl_stats;
+
+static void control_kick(void) {
+    __atomic_add_fetch(&ctl_seq, 1, __ATOMIC_RELEASE);
+    hpsdr_futex_wake(&ctl_seq);
+}
+
+static void control_command(hpsdr_ctl_cmd_t *cmd) {
+    switch (cmd->type) {
+        case CTL_PROGRAM:
+            hpsdr_program(cmd->data);
+            hpsdr_network_reply(cmd->data, 60, &cmd->to);
+            break;
+        case CTL_ERASE:
+            hpsdr_erase_packet(cmd->data);
+            hpsdr_network_reply(cmd->data, 60, &cmd->to);
+            break;
+        case CTL_SETIP:
+            hpsdr_set_ip(cmd->data);
+            hpsdr_network_reply(cmd->data, 63, &cmd->to);
+            break;
+    }
+    ctl_stats.commands++;
+}
+
+static void* control_worker(void *arg) {
+    hpsdr_ctl_cmd_t cmd;
+    uint32_t seq;
+    uint64_t start, busy;
+
+    while (__atomic_load_n(&ctl_run, __ATOMIC_ACQUIRE)) {
+        seq = __atomic_load_n(&ctl_seq, __ATOMIC_ACQUIRE);
+
+        // however many changes came in meanwhile, retune once to the latest frequency
+        if (__atomic_exchange_n(&ctl_retune, 0, __ATOMIC_ACQ_REL)) {
+            start = hpsdr_pipeline_now();
+            iqsender_set();
+            busy = hpsdr_pipeline_now() - start;
+            ctl_stats.retunes++;
+            if (busy > ctl_stats.retune_max_ns)
+                ctl_stats.retune_max_ns = busy;
+        }
+
+        while (hpsdr_queue_pop(&ctl_queue, &cmd))
+            control_command(&cmd);
+
+        hpsdr_futex_wait(&ctl_seq, seq, -1);
+    }
+
+    return NULL;
+}
+
+int hpsdr_control_init(void) {
+    if (hpsdr_queue_init(&ctl_queue, CTL_QUEUE, sizeof(hpsdr_ctl_cmd_t)) < 0) {
+        hpsdr_dbg_printf(0, "ERROR: control queue not allocated\n");
+        return -1;
+    }
+
+    ctl_run = true;
+    if (pthread_create(&ctl_id, NULL, control_worker, NULL) != 0) {
+        hpsdr_dbg_printf(0, "ERROR: create control thread\n");
+        ctl_run = false;
+        hpsdr_queue_deinit(&ctl_queue);
+        return -1;
+    }
+
+    return 0;
+}
+
+void hpsdr_control_deinit(void) {
+    if (!ctl_run)
+        return;
+
+    __atomic_store_n(&ctl_run, false, __ATOMIC_RELEASE);
+    control_kick();
+    pthread_join(ctl_id, NULL);
+    hpsdr_queue_deinit(&ctl_queue);
+}
+
+// settings.tx_freq changed: the control worker picks the latest value up
+void hpsdr_control_retune(void) {
+    __atomic_add_fetch(&ctl_stats.retune_requests, 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&ctl_retune, 1, __ATOMIC_RELEASE);
+    control_kick();
+}
+
+// network thread only: the reply goes to from once the command is done
+void hpsdr_control_post(hpsdr_ctl_type_t type, const uint8_t *packet, size_t len, const struct sockaddr_in *from) {
+    hpsdr_ctl_cmd_t cmd;
+
+    cmd.type = type;
+    cmd.to = *from;
+    memset(cmd.data, 0, sizeof(cmd.data));
+    memcpy(cmd.data, packet, len < sizeof(cmd.data) ? len : sizeof(cmd.data));
+
+    if (!hpsdr_queue_push(&ctl_queue, &cmd)) {
+        hpsdr_dbg_printf(1, "Control queue full, command %d dropped\n", type);
+        ctl_stats.dropped++;
+        return;
+    }
+    control_kick();
+}
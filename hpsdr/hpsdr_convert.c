@@ -0,0 +1,249 @@
+/*
+ * Copyright 2021 Emiliano Gonzalez LU3VEA (lu3vea @ gmail . com))
+ * * Project Site: https://github.com/hiperiondev/hpsdr-p1-rpitx *
+ *
+ * This is based on other projects:
+ *    librpitx (https://github.com/F5OEO/librpitx)
+ *    HPSDR simulator (https://github.com/g0orx/pihpsdr)
+ *    small-memory XML config database library (https://github.com/dleonard0/mxml)
+ *
+ *    please contact their authors for more information.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ *
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <complex.h>
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "hpsdr_debug.h"
+#include "hpsdr_convert.h"
+
+// cleared by hpsdr_convert_init if the vector kernel does not match the scalar one
+static bool use_simd = true;
+
+// n groups of 8 bytes L1 L0 R1 R0 I1 I0 Q1 Q0 (big endian) to n complex samples
+void hpsdr_convert_iq_scalar(const uint8_t *src, float _Complex *dst, int n) {
+    float *out = (float*) dst;
+
+    for (int j = 0; j < n; j++, src += 8) {
+        int16_t i = (int16_t) ((src[4] << 8) | src[5]);
+        int16_t q = (int16_t) ((src[6] << 8) | src[7]);
+
+        out[2 * j] = (float) i * CONVERT_SCALE;
+        out[2 * j + 1] = (float) q * CONVERT_SCALE;
+    }
+}
+
+// n groups of 8 bytes to n native endian I/Q int16 pairs
+void hpsdr_convert_iq16_scalar(const uint8_t *src, int16_t *dst, int n) {
+    for (int j = 0; j < n; j++, src += 8) {
+        dst[2 * j] = (int16_t) ((src[4] << 8) | src[5]);
+        dst[2 * j + 1] = (int16_t) ((src[6] << 8) | src[7]);
+    }
+}
+
+// n I/Q int16 pairs to n complex samples
+void hpsdr_convert_s16_scalar(const int16_t *src, float _Complex *dst, int n) {
+    float *out = (float*) dst;
+
+    for (int j = 0; j < 2 * n; j++)
+        out[j] = (float) src[j] * CONVERT_SCALE;
+}
+
+#if defined(__ARM_NEON)
+// 8 samples per round: vld4 splits L/R/I/Q, vst2 interleaves I/Q again
+static int convert_iq_simd(const uint8_t *src, float _Complex *dst, int n) {
+    float *out = (float*) dst;
+    int j;
+
+    for (j = 0; j + 8 <= n; j += 8, src += 64, out += 16) {
+        int16x8x4_t in = vld4q_s16((const int16_t*) src);
+        int16x8_t i = vreinterpretq_s16_u8(vrev16q_u8(vreinterpretq_u8_s16(in.val[2])));
+        int16x8_t q = vreinterpretq_s16_u8(vrev16q_u8(vreinterpretq_u8_s16(in.val[3])));
+        float32x4x2_t lo, hi;
+
+        lo.val[0] = vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(i))), CONVERT_SCALE);
+        lo.val[1] = vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(q))), CONVERT_SCALE);
+        hi.val[0] = vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(i))), CONVERT_SCALE);
+        hi.val[1] = vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(q))), CONVERT_SCALE);
+        vst2q_f32(out, lo);
+        vst2q_f32(out + 8, hi);
+    }
+
+    return j;
+}
+
+static int convert_iq16_simd(const uint8_t *src, int16_t *dst, int n) {
+    int j;
+
+    for (j = 0; j + 8 <= n; j += 8, src += 64, dst += 16) {
+        int16x8x4_t in = vld4q_s16((const int16_t*) src);
+        int16x8x2_t out;
+
+        out.val[0] = vreinterpretq_s16_u8(vrev16q_u8(vreinterpretq_u8_s16(in.val[2])));
+        out.val[1] = vreinterpretq_s16_u8(vrev16q_u8(vreinterpretq_u8_s16(in.val[3])));
+        vst2q_s16(dst, out);
+    }
+
+    return j;
+}
+
+// 4 samples per round, the I/Q order is kept so no de-interleave is needed
+static int convert_s16_simd(const int16_t *src, float _Complex *dst, int n) {
+    float *out = (float*) dst;
+    int j;
+
+    for (j = 0; j + 4 <= n; j += 4, src += 8, out += 8) {
+        int16x8_t iq = vld1q_s16(src);
+
+        vst1q_f32(out, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(iq))), CONVERT_SCALE));
+        vst1q_f32(out + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(iq))), CONVERT_SCALE));
+    }
+
+    return j;
+}
+#elif defined(__SSE2__)
+// 4 samples per round: keep the I/Q words of each group, swap bytes, widen and scale
+static int convert_iq_simd(const uint8_t *src, float _Complex *dst, int n) {
+    const __m128 scale = _mm_set1_ps(CONVERT_SCALE);
+    float *out = (float*) dst;
+    int j;
+
+    for (j = 0; j + 4 <= n; j += 4, src += 32, out += 8) {
+        __m128i a = _mm_loadu_si128((const __m128i*) src);
+        __m128i b = _mm_loadu_si128((const __m128i*) (src + 16));
+        __m128i iq = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(a), _mm_castsi128_ps(b), _MM_SHUFFLE(3, 1, 3, 1)));
+
+        iq = _mm_or_si128(_mm_slli_epi16(iq, 8), _mm_srli_epi16(iq, 8));
+        _mm_storeu_ps(out, _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(iq, iq), 16)), scale));
+        _mm_storeu_ps(out + 4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(iq, iq), 16)), scale));
+    }
+
+    return j;
+}
+
+static int convert_iq16_simd(const uint8_t *src, int16_t *dst, int n) {
+    int j;
+
+    for (j = 0; j + 4 <= n; j += 4, src += 32, dst += 8) {
+        __m128i a = _mm_loadu_si128((const __m128i*) src);
+        __m128i b = _mm_loadu_si128((const __m128i*) (src + 16));
+        __m128i iq = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(a), _mm_castsi128_ps(b), _MM_SHUFFLE(3, 1, 3, 1)));
+
+        _mm_storeu_si128((__m128i*) dst, _mm_or_si128(_mm_slli_epi16(iq, 8), _mm_srli_epi16(iq, 8)));
+    }
+
+    return j;
+}
+
+static int convert_s16_simd(const int16_t *src, float _Complex *dst, int n) {
+    const __m128 scale = _mm_set1_ps(CONVERT_SCALE);
+    float *out = (float*) dst;
+    int j;
+
+    for (j = 0; j + 4 <= n; j += 4, src += 8, out += 8) {
+        __m128i iq = _mm_loadu_si128((const __m128i*) src);
+
+        _mm_storeu_ps(out, _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(iq, iq), 16)), scale));
+        _mm_storeu_ps(out + 4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(iq, iq), 16)), scale));
+    }
+
+    return j;
+}
+#else
+static int convert_iq_simd(const uint8_t *src, float _Complex *dst, int n) {
+    return 0;
+}
+
+static int convert_iq16_simd(const uint8_t *src, int16_t *dst, int n) {
+    return 0;
+}
+
+static int convert_s16_simd(const int16_t *src, float _Complex *dst, int n) {
+    return 0;
+}
+#endif
+
+void hpsdr_convert_iq(const uint8_t *src, float _Complex *dst, int n) {
+    int j = use_simd ? convert_iq_simd(src, dst, n) : 0;
+
+    hpsdr_convert_iq_scalar(src + 8 * j, dst + j, n - j);
+}
+
+void hpsdr_convert_iq16(const uint8_t *src, int16_t *dst, int n) {
+    int j = use_simd ? convert_iq16_simd(src, dst, n) : 0;
+
+    hpsdr_convert_iq16_scalar(src + 8 * j, dst + 2 * j, n - j);
+}
+
+void hpsdr_convert_s16(const int16_t *src, float _Complex *dst, int n) {
+    int j = use_simd ? convert_s16_simd(src, dst, n) : 0;
+
+    hpsdr_convert_s16_scalar(src + 2 * j, dst + j, n - j);
+}
+
+const char* hpsdr_convert_kernel(void) {
+#if defined(__ARM_NEON)
+    return use_simd ? "neon" : "scalar";
+#elif defined(__SSE2__)
+    return use_simd ? "sse2" : "scalar";
+#else
+    return "scalar";
+#endif
+}
+
+// run both kernels over every 16 bit I and Q value once, fall back to scalar on any difference
+int hpsdr_convert_init(void) {
+    uint8_t src[8 * 63];
+    float _Complex simd[63], ref[63];
+    int16_t simd16[2 * 63], ref16[2 * 63];
+    uint32_t v = 0;
+
+    memset(src, 0xa5, sizeof(src));
+    while (v < 0x10000) {
+        for (int n = 0; n < 8 * 63; n += 8, v += 2) {
+            src[n + 4] = v >> 8;
+            src[n + 5] = v;
+            src[n + 6] = (v + 1) >> 8;
+            src[n + 7] = v + 1;
+        }
+        hpsdr_convert_iq(src, simd, 63);
+        hpsdr_convert_iq_scalar(src, ref, 63);
+        hpsdr_convert_iq16(src, simd16, 63);
+        hpsdr_convert_iq16_scalar(src, ref16, 63);
+        if (memcmp(simd, ref, sizeof(ref)) == 0 && memcmp(simd16, ref16, sizeof(ref16)) == 0) {
+            hpsdr_convert_s16(ref16, simd, 63);
+            hpsdr_convert_s16_scalar(ref16, ref, 63);
+        }
+        if (memcmp(simd, ref, sizeof(ref)) != 0 || memcmp(simd16, ref16, sizeof(ref16)) != 0) {
+            hpsdr_dbg_printf(0, "WARNING: %s sample conversion differs from scalar, not used\n", hpsdr_convert_kernel());
+            use_simd = false;
+            return -1;
+        }
+    }
+
+    hpsdr_dbg_printf(1, "tx sample conversion: %s\n", hpsdr_convert_kernel());
+    return 0;
+}
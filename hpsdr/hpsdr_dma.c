@@ -0,0 +1,83 @@
+/*
+ * Copyright 2021 Emiliano Gonzalez LU3VEA (lu3vea @ gmail . com))
+ * * Project Site: https://github.com/hiperiondev/hpsdr-p1-rpitx *
+ *
+ * This is based on other projects:
+ *    librpitx (https://github.com/F5OEO/librpitx)
+ *    HPSDR simulator (https://github.com/g0orx/pihpsdr)
+ *    small-memory XML config database library (https://github.com/dleonard0/mxml)
+ *
+ *    please contact their authors for more information.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ *
+ */
+
+#include <stdint.h>
+#include <complex.h>
+
+#include "hpsdr_debug.h"
+#include "hpsdr_main.h"
+#include "hpsdr_dma.h"
+
+#include "librpitx.h"
+
+#define Harmonic 1
+
+const hpsdr_dma_backend_t *dma = &dma_rpitx;
+hpsdr_dma_stats_t dma_stats;
+
+void hpsdr_dma_select(dma_backend_t type) {
+    dma = type == DMA_VIRTUAL ? &dma_virtual : &dma_rpitx;
+    hpsdr_dbg_printf(1, "DMA backend: %s\n", dma->name);
+}
+
+static int rpitx_init(uint64_t frequency, int samplerate, int fifosize) {
+    float ppmpll = 0.0;
+
+    iqdmasync_init(&(tx_arg.iqsender), frequency, samplerate, 14, fifosize, MODE_IQ);
+    iqdmasync_set_ppm(&(tx_arg.iqsender), ppmpll);
+
+    return tx_arg.iqsender != NULL ? 0 : -1;
+}
+
+// the public iqdmasync api has no in-place retune
+static int rpitx_set_frequency(uint64_t frequency) {
+    return -1;
+}
+
+static void rpitx_push(float _Complex *samples, int len) {
+    iqdmasync_set_iq_samples(&(tx_arg.iqsender), samples, len, Harmonic);
+    dma_stats.pushes++;
+    dma_stats.samples += len;
+}
+
+static void rpitx_deinit(void) {
+    if (tx_arg.iqsender == NULL) {
+        hpsdr_dbg_printf(0, "ERROR: iqsender NULL\n");
+        return;
+    }
+
+    iqdmasync_deinit(&(tx_arg.iqsender));
+}
+
+const hpsdr_dma_backend_t dma_rpitx = {
+        .name = "rpitx",
+        .init = rpitx_init,
+        .set_frequency = rpitx_set_frequency,
+        .push = rpitx_push,
+        .deinit = rpitx_deinit
+};
@@ -0,0 +1,127 @@
+/*
+ * Copyright 2021 Emiliano Gonzalez LU3VEA (lu3vea @ gmail . com))
+ * * Project Site: https://github.com/hiperiondev/hpsdr-p1-rpitx *
+ *
+ * This is based on other projects:
+ *    librpitx (https://github.com/F5OEO/librpitx)
+ *    HPSDR simulator (https://github.com/g0orx/pihpsdr)
+ *    small-memory XML config database library (https://github.com/dleonard0/mxml)
+ *
+ *    please contact their authors for more information.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ *
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <complex.h>
+#include <time.h>
+
+#include "hpsdr_debug.h"
+#include "hpsdr_main.h"
+#include "hpsdr_dma.h"
+
+// a fifo of fifosize samples drained at samplerate (plus config.tx.dmappm) against CLOCK_MONOTONIC
+static double rate;       // samples per ns
+static int64_t fifo;
+static int64_t base;      // time the queued count starts from
+static double queued;     // samples pushed since base
+static FILE *out = NULL;
+static uint64_t freq;
+
+static int64_t virtual_now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t) ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int virtual_init(uint64_t frequency, int samplerate, int fifosize) {
+    rate = samplerate * (1.0 + config.tx.dmappm * 1e-6) / 1e9;
+    fifo = fifosize;
+    freq = frequency;
+    base = virtual_now();
+    queued = 0;
+
+    if (config.tx.dmafile != NULL && out == NULL) {
+        out = fopen(config.tx.dmafile, "wb");
+        if (out == NULL)
+            hpsdr_dbg_printf(0, "ERROR: can't open %s\n", config.tx.dmafile);
+    }
+    hpsdr_dbg_printf(1, "virtual dma: %llu Hz, %d samples/s %+d ppm, fifo %d\n", (unsigned long long) frequency, samplerate,
+            config.tx.dmappm, fifosize);
+
+    return 0;
+}
+
+static int virtual_set_frequency(uint64_t frequency) {
+    freq = frequency;
+    return 0;
+}
+
+static void virtual_push(float _Complex *samples, int len) {
+    int64_t now = virtual_now();
+    double level = queued - (now - base) * rate;
+
+    // ran dry: the real dma would have gone on sending, start the clock again from here
+    if (level < 0.0) {
+        if (dma_stats.pushes > 0) {
+            dma_stats.underruns++;
+            dma_stats.starved += -level;
+        }
+        base = now;
+        queued = 0;
+        level = 0.0;
+    }
+
+    // full: wait until the fifo has room, as iqdmasync_set_iq_samples does
+    if (level + len > fifo) {
+        struct timespec ts;
+        int64_t until = now + (int64_t) ((level + len - fifo) / rate);
+
+        dma_stats.overruns++;
+        ts.tv_sec = until / 1000000000LL;
+        ts.tv_nsec = until % 1000000000LL;
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) != 0)
+            ;
+        level = fifo - len;
+    }
+
+    queued += len;
+    dma_stats.level = level + len;
+    dma_stats.pushes++;
+    dma_stats.samples += len;
+
+    if (out != NULL && fwrite(samples, sizeof(float _Complex), len, out) != (size_t) len) {
+        hpsdr_dbg_printf(0, "ERROR: writing %s, output file closed\n", config.tx.dmafile);
+        fclose(out);
+        out = NULL;
+    }
+}
+
+static void virtual_deinit(void) {
+    if (out != NULL)
+        fflush(out);
+}
+
+const hpsdr_dma_backend_t dma_virtual = {
+        .name = "virtual",
+        .init = virtual_init,
+        .set_frequency = virtual_set_frequency,
+        .push = virtual_push,
+        .deinit = virtual_deinit
+};
@@ -26,11 +26,13 @@
  *
  */
 
+#include <stdlib.h>
 #include <unistd.h>
 #include <stdint.h>
 #include <time.h>
 #include <string.h>
 #include <math.h>
+#include <stdbool.h>
 #include <pthread.h>
 
 #include "hpsdr_debug.h"
@@ -39,146 +41,481 @@
 #include "hpsdr_network.h"
 #include "hpsdr_protocol.h"
 #include "hpsdr_iq_tx.h"
+#include "hpsdr_pipeline.h"
+#include "hpsdr_futex.h"
+#include "hpsdr_ep6.h"
+#include "hpsdr_control.h"
+#include "hpsdr_rx.h"
+#include "hpsdr_ring.h"
+#include "hpsdr_flow.h"
 
-void* ep6_handler(void *arg) {
-    hpsdr_dbg_printf(1, "Start handler ep6\n");
+static uint8_t id[4] = {
+        0xef,
+        0xfe,
+        1,
+        6
+};
+static uint8_t header[40] = {
+     // C0   C1   C2   C3   C4
+        127, 127, 127, 0,   0,
+        33,  17,  21,  127, 127,
+        127, 8,   0,   0,   0,
+        0,   127, 127, 127, 16,
+        0,   0,   0,   0,   127,
+        127, 127, 24,  0,   0,
+        0,   0,   127, 127, 127,
+        32,  66,  66,  66,  66
+};
+
+// ring of frames built ahead and flushed together once per pacing tick
+static uint8_t *frames = NULL;
+static uint32_t counter;
+
+// one prebuilt frame per c&c slot the frame starts on (each frame carries two), only the
+// sequence number and the telemetry are patched per frame
+#define EP6_SLOTS 5
+
+static uint8_t templates[EP6_SLOTS][1032];
+static int fwd_power[EP6_SLOTS];  // offset of the forward power bytes in each template, 0 for none
+static int slot;                  // template of the next frame
+static int frame_n;               // samples per 512-byte-block
+static uint32_t frame_rate;       // receiver sample rate (Hz)
+static struct {
+    int device;
+    int receivers;
+    int rate;
+    int txdrive;
+} built = { -1, -1, -1, -1 };
+
+// A batch is due when the time for all samples sent since base has passed. The deadline is
+// computed from the sample count every time, so rounding never adds up to drift.
+#define EP6_BURST_MAX 100000000ULL  // ns late at most made up by sending back to back, more resyncs
+
+static struct {
+    uint64_t base;      // CLOCK_MONOTONIC ns
+    uint64_t samples;   // per receiver, since base
+    uint32_t rate;      // Hz
+    double speed;       // flow control: rate offset since base, + sends faster
+    uint64_t deadline;  // of the batch built last
+} pace;
+
+static uint64_t window_start;  // achieved rate over about a second
+static uint64_t window_samples;
+
+// session state, changed by the network thread (requests) and the worker
+static uint32_t ep6_state = EP6_IDLE;
+static uint64_t ep6_request_ns;  // time of the last start or stop request
+static pthread_t ep6_id;
+static bool ep6_threaded = false;
+
+hpsdr_ep6_stats_t ep6_stats;
+
+// c&c bytes for the given slot, what the protocol fills in per slot lives here
+static void ep6_cc(uint8_t *pointer, int cc, int frame_offset, int t) {
+    memcpy(pointer, header + cc * 8, 8);
+
+    switch (cc) {
+    case 0:
+        // do not set ptt and cw in c0
+        // do not set adc overflow in c1
+        if (built.device == DEVICE_HERMES_LITE2) {
+            *(pointer + 5) = 0;
+            *(pointer + 6) = 0;
+        }
+        break;
+    case 1:
+        if (built.device == DEVICE_HERMES_LITE2) {
+            // hl2: temperature
+            *(pointer + 4) = 0;
+            *(pointer + 5) = 0;  // pseudo random number
+        } else {
+            // ain5: exciter power
+            *(pointer + 4) = 0;  // about 500 mW
+            *(pointer + 5) = built.txdrive;
+        }
+        // ain1: forward power, patched per frame
+        *(pointer + 6) = 0;
+        *(pointer + 7) = 0;
+        fwd_power[t] = frame_offset + 6;
+        break;
+    case 2:
+        // ain2: reverse power
+        // ain3:
+        break;
+    case 3:
+        // ain4:
+        // ain5: supply voltage
+        *(pointer + 6) = 0;
+        *(pointer + 7) = 63;
+        break;
+    case 4:
+        break;
+    }
+}
 
+// rebuild the templates when a setting they depend on has changed
+static void ep6_templates(void) {
+    int n;
+
+    if (built.device == device_emulation && built.receivers == settings.receivers && built.rate == settings.rate
+            && built.txdrive == settings.txdrive)
+        return;
+
+    built.device = device_emulation;
+    built.receivers = settings.receivers;
+    built.rate = settings.rate;
+    built.txdrive = settings.txdrive;
+
+    n = 504 / (built.receivers * 6 + 2);  // number of samples per 512-byte-block
+    frame_n = n;
+    frame_rate = 48000 << built.rate;
+
+    // i/q and microphone samples: silence
+    for (int t = 0; t < EP6_SLOTS; t++) {
+        memset(templates[t], 0, 1032);
+        memcpy(templates[t], id, 4);
+        fwd_power[t] = 0;
+        for (int i = 0; i < 2; ++i)
+            ep6_cc(templates[t] + 8 + i * 512, (t + i) % EP6_SLOTS, 8 + i * 512, t);
+    }
+    ++ep6_stats.rebuilds;
+}
+
+// frame from the template for the current slot, the receiver samples from the rx source if there is one
+static void ep6_fill(uint8_t *buffer) {
     static double txlevel;
-    int i, j;
-    int k, n;
-    int size;
-    int header_offset;
-    uint32_t counter;
-    uint8_t buffer[1032];
-    uint8_t *pointer;
-    struct timespec delay;
-    long wait;
-
-    uint8_t id[4] = {
-            0xef,
-            0xfe,
-            1,
-            6
-    };
-    uint8_t header[40] = {
-         // C0   C1   C2   C3   C4
-            127, 127, 127, 0,   0,
-            33,  17,  21,  127, 127,
-            127, 8,   0,   0,   0,
-            0,   127, 127, 127, 16,
-            0,   0,   0,   0,   127,
-            127, 127, 24,  0,   0,
-            0,   0,   127, 127, 127,
-            32,  66,  66,  66,  66
-    };
-
-    memcpy(buffer, id, 4);
-    header_offset = 0;
+    int j;
+
+    memcpy(buffer, templates[slot], 1032);
+
+    // plug in sequence numbers
+    *(uint32_t*) (buffer + 4) = htonl(counter);
+    ++counter;
+
+    if (fwd_power[slot]) {
+        j = (int) ((4095.0 / c1) * sqrt(100.0 * txlevel * c2));
+        buffer[fwd_power[slot]] = (j >> 8) & 0xFF;
+        buffer[fwd_power[slot] + 1] = (j) & 0xFF;
+    }
+
+    if (rx != NULL) {
+        hpsdr_rx_pack(buffer + 16, frame_n, built.receivers);
+        hpsdr_rx_pack(buffer + 528, frame_n, built.receivers);
+    }
+
+    slot = (slot + 2) % EP6_SLOTS;
+}
+
+int ep6_start(void) {
+    hpsdr_dbg_printf(1, "Start handler ep6\n");
+
+    frames = malloc(config.global.txbatch * 1032);
+    if (frames == NULL) {
+        hpsdr_dbg_printf(0, "ERROR: ep6 frames not allocated\n");
+        return -1;
+    }
+
+    slot = 0;
     counter = 0;
 
-    iqsender_set();
+    pace.base = pace.deadline = hpsdr_pipeline_now();
+    pace.samples = 0;
+    pace.speed = 0.0;
+    if (config.global.flowcontrol)
+        hpsdr_flow_reset();
+    ep6_stats.session_ns = window_start = pace.base;
+    ep6_stats.samples = window_samples = 0;
 
-    clock_gettime(CLOCK_MONOTONIC, &delay);
-    while (1) {
-        if (!enable_thread)
-            break;
+    hpsdr_control_retune();
 
-        size = settings.receivers * 6 + 2;
-        n = 504 / size;  // number of samples per 512-byte-block
-        // time (in nanosecs) to "collect" the samples sent in one sendmsg
-        if ((48 << settings.rate) == 0) {
-            wait = (2 * n * 1000000L);
-        } else {
-            wait = (2 * n * 1000000L) / (48 << settings.rate);
+    return 0;
+}
+
+void ep6_stop(void) {
+    free(frames);
+    frames = NULL;
+
+    iqsender_clear_buffer();
+
+    hpsdr_dbg_printf(1, "Stop handler_ep6\n");
+}
+
+// build frame number frame of the batch
+static void ep6_frame(int frame) {
+    uint64_t start;
+
+    start = hpsdr_pipeline_now();
+    ep6_fill(frames + frame * 1032);
+    hpsdr_pipeline_account(STAGE_EP6, start, 1);
+}
+
+// time (in nanosecs) samples stand for at rate, exact to the nanosecond without overflow
+static uint64_t pace_ns(uint64_t samples, uint32_t rate) {
+    return samples / rate * 1000000000ULL + samples % rate * 1000000000ULL / rate;
+}
+
+static unsigned ep6_batch_samples(void) {
+    return config.global.txbatch * 2 * frame_n;
+}
+
+// frame build cost against a plain copy of the same size, with the current settings
+void ep6_bench(void) {
+    uint8_t *buf = malloc(2 * 1032);
+    int save_slot = slot;
+    uint32_t save_counter = counter;
+    const hpsdr_rx_source_t *source = rx;
+    uint64_t start, fill_ns, copy_ns;
+    const int runs = 100000;
+
+    if (buf == NULL)
+        return;
+
+    // the template path alone, playback stays where it is
+    rx = NULL;
+
+    ep6_templates();
+    start = hpsdr_pipeline_now();
+    for (int r = 0; r < runs; r++) {
+        ep6_fill(buf + (r & 1) * 1032);
+        __asm__ volatile("" : : "r"(buf) : "memory");  // keep the stores
+    }
+    fill_ns = hpsdr_pipeline_now() - start;
+
+    start = hpsdr_pipeline_now();
+    for (int r = 0; r < runs; r++) {
+        memcpy(buf + (r & 1) * 1032, templates[r % EP6_SLOTS], 1032);
+        __asm__ volatile("" : : "r"(buf) : "memory");
+    }
+    copy_ns = hpsdr_pipeline_now() - start;
+
+    hpsdr_dbg_printf(1, "ep6 frame benchmark (%d receivers): %.1f ns/frame, memcpy %.1f ns/frame\n", built.receivers,
+            (double) fill_ns / runs, (double) copy_ns / runs);
+
+    slot = save_slot;
+    counter = save_counter;
+    rx = source;
+    free(buf);
+}
+
+// build a batch of frames, ep6_deadline tells when it is due
+void ep6_build(void) {
+    int frame;
+    uint64_t t;
+
+    ep6_templates();
+    if (pace.rate != frame_rate) {
+        // new sample rate: count from the last deadline again
+        pace.base = pace.deadline;
+        pace.samples = 0;
+        pace.rate = frame_rate;
+        ep6_stats.rate = frame_rate;
+    }
+    if (config.global.flowcontrol) {
+        hpsdr_flow_sample(hpsdr_ring_fill(&iq_ring));
+        if (hpsdr_flow_update(hpsdr_pipeline_now())) {
+            // new offset: count from the last deadline again, so it only applies from here on
+            pace.base = pace.deadline;
+            pace.samples = 0;
+            pace.speed = flow_stats.ppm * 1e-6;
+        }
+    }
+
+    for (frame = 0; frame < config.global.txbatch; frame++)
+        ep6_frame(frame);
+
+    pace.samples += ep6_batch_samples();
+    t = pace_ns(pace.samples, pace.rate);
+    pace.deadline = pace.base + t - (int64_t) (t * pace.speed);
+}
+
+uint64_t ep6_deadline(void) {
+    return pace.deadline;
+}
+
+// the batch built last is going out at now: count a missed deadline and decide how to catch up
+void ep6_late(uint64_t now) {
+    uint64_t late = now > pace.deadline ? now - pace.deadline : 0;
+
+    if (late > ep6_stats.late_max_ns)
+        ep6_stats.late_max_ns = late;
+
+    // within a batch period: ordinary wakeup jitter
+    if (late <= pace_ns(ep6_batch_samples(), pace.rate))
+        return;
+
+    ++ep6_stats.missed;
+    if (config.global.catchup == CATCHUP_SKIP || late > EP6_BURST_MAX) {
+        // drop the samples that were due meanwhile, pace from now on
+        ++ep6_stats.resyncs;
+        ep6_stats.skipped_ns += late;
+        pace.base = pace.deadline = now;
+        pace.samples = 0;
+    }
+    // burst: the next deadlines have passed as well, those batches go out back to back
+}
+
+void ep6_send(void) {
+    uint64_t start = hpsdr_pipeline_now();
+
+    hpsdr_network_send_batch(frames, config.global.txbatch);
+    hpsdr_pipeline_account(STAGE_EP6, start, 0);
+
+    ep6_stats.samples += ep6_batch_samples();
+    window_samples += ep6_batch_samples();
+    if (start > ep6_stats.session_ns)
+        ep6_stats.rate_session = ep6_stats.samples * 1e9 / (start - ep6_stats.session_ns);
+    if (start - window_start >= 1000000000ULL) {
+        ep6_stats.rate_now = window_samples * 1e9 / (start - window_start);
+        window_start = start;
+        window_samples = 0;
+    }
+}
+
+static bool ts_before(const struct timespec *a, const struct timespec *b) {
+    return a->tv_sec < b->tv_sec || (a->tv_sec == b->tv_sec && a->tv_nsec < b->tv_nsec);
+}
+
+// sleep until deadline, or less if the state leaves running
+static void ep6_sleep_until(const struct timespec *deadline) {
+    struct timespec now;
+
+    do {
+        hpsdr_futex_wait_until(&ep6_state, EP6_RUNNING, deadline);
+        clock_gettime(CLOCK_MONOTONIC, &now);
+    } while (__atomic_load_n(&ep6_state, __ATOMIC_ACQUIRE) == EP6_RUNNING && ts_before(&now, deadline));
+}
+
+static bool ep6_move(uint32_t from, uint32_t to) {
+    return __atomic_compare_exchange_n(&ep6_state, &from, to, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
+
+static void ep6_latency(uint64_t *count, uint64_t *max, uint64_t *sum) {
+    uint64_t latency = hpsdr_pipeline_now() - __atomic_load_n(&ep6_request_ns, __ATOMIC_RELAXED);
+
+    ++*count;
+    *sum += latency;
+    if (latency > *max)
+        *max = latency;
+}
+
+// one session at a time, for the life of the program
+static void* ep6_worker(void *arg) {
+    struct timespec delay;
+    uint32_t state;
+
+    hpsdr_pipeline_pin(STAGE_EP6);
 
+    while ((state = __atomic_load_n(&ep6_state, __ATOMIC_ACQUIRE)) != EP6_EXIT) {
+        if (state == EP6_STOPPING) {
+            // stop requested before the session got going
+            ep6_move(EP6_STOPPING, EP6_IDLE);
+            continue;
+        }
+        if (state != EP6_STARTING) {
+            hpsdr_futex_wait(&ep6_state, state, -1);
+            continue;
         }
 
-        // plug in sequence numbers
-        *(uint32_t*) (buffer + 4) = htonl(counter);
-        ++counter;
-
-        for (i = 0; i < 2; ++i) {
-            pointer = buffer + i * 516 - i % 2 * 4 + 8;
-            memcpy(pointer, header + header_offset, 8);
-
-            switch (header_offset) {
-            case 0:
-                // do not set ptt and cw in c0
-                // do not set adc overflow in c1
-                if (device_emulation == DEVICE_HERMES_LITE2) {
-                    *(pointer + 5) = (0 >> 8) & 0x7F;
-                    *(pointer + 6) = 0 & 0xFF;
-                }
-                header_offset = 8;
-                break;
-            case 8:
-                if (device_emulation == DEVICE_HERMES_LITE2) {
-                    // hl2: temperature
-                    *(pointer + 4) = 0;
-                    *(pointer + 5) = 0 & 0x7F;  // pseudo random number
-                } else {
-                    // ain5: exciter power
-                    *(pointer + 4) = 0;  // about 500 mW
-                    *(pointer + 5) = settings.txdrive;
-                }
-                // ain1: forward power
-                j = (int) ((4095.0 / c1) * sqrt(100.0 * txlevel * c2));
-                *(pointer + 6) = (j >> 8) & 0xFF;
-                *(pointer + 7) = (j) & 0xFF;
-                header_offset = 16;
-                break;
-            case 16:
-                // ain2: reverse power
-                // ain3:
-                header_offset = 24;
-                break;
-            case 24:
-                // ain4:
-                // ain5: supply voltage
-                *(pointer + 6) = 0;
-                *(pointer + 7) = 63;
-                header_offset = 32;
-                break;
-            case 32:
-                header_offset = 0;
+        if (ep6_start() < 0) {
+            ep6_move(EP6_STARTING, EP6_IDLE);
+            continue;
+        }
+        if (!ep6_move(EP6_STARTING, EP6_RUNNING)) {
+            ep6_stop();
+            continue;
+        }
+        ep6_latency(&ep6_stats.sessions, &ep6_stats.start_max_ns, &ep6_stats.start_sum_ns);
+
+        while (__atomic_load_n(&ep6_state, __ATOMIC_ACQUIRE) == EP6_RUNNING) {
+            // wait until the time has passed for all these samples
+            ep6_build();
+            delay.tv_sec = ep6_deadline() / 1000000000ULL;
+            delay.tv_nsec = ep6_deadline() % 1000000000ULL;
+
+            ep6_sleep_until(&delay);
+            if (__atomic_load_n(&ep6_state, __ATOMIC_ACQUIRE) != EP6_RUNNING)
                 break;
-            }
-
-            pointer += 8;
-            memset(pointer, 0, 504);
-
-            for (j = 0; j < n; j++) {
-                for (k = 0; k < settings.receivers; k++) {
-                    *pointer++ = (0 >> 16) & 0xFF;
-                    *pointer++ = (0 >> 8) & 0xFF;
-                    *pointer++ = (0 >> 0) & 0xFF;
-                    *pointer++ = (0 >> 16) & 0xFF;
-                    *pointer++ = (0 >> 8) & 0xFF;
-                    *pointer++ = (0 >> 0) & 0xFF;
-                }
-                // microphone samples: silence
-                pointer += 2;
-            }
+
+            ep6_late(hpsdr_pipeline_now());
+            ep6_send();
         }
 
-        // wait until the time has passed for all these samples
-        delay.tv_nsec += wait;
-        while (delay.tv_nsec >= 1000000000) {
-            delay.tv_nsec -= 1000000000;
-            delay.tv_sec++;
+        // frames stopped here; a restart leaves the state at starting and goes round again
+        if (__atomic_load_n(&ep6_state, __ATOMIC_ACQUIRE) == EP6_STOPPING)
+            ep6_latency(&ep6_stats.stops, &ep6_stats.stop_max_ns, &ep6_stats.stop_sum_ns);
+        ep6_stop();
+        ep6_move(EP6_STOPPING, EP6_IDLE);
+    }
+
+    return NULL;
+}
+
+int ep6_init(void) {
+    if (config.global.bench)
+        ep6_bench();
+
+    // in single run mode the network loop runs the session itself
+    if (config.global.runmode == RUN_SINGLE)
+        return 0;
+
+    if (pthread_create(&ep6_id, NULL, ep6_worker, NULL) != 0) {
+        hpsdr_dbg_printf(0, "ERROR: create ep6 thread\n");
+        return -1;
+    }
+    ep6_threaded = true;
+
+    return 0;
+}
+
+void ep6_deinit(void) {
+    if (ep6_threaded) {
+        __atomic_store_n(&ep6_state, EP6_EXIT, __ATOMIC_RELEASE);
+        hpsdr_futex_wake(&ep6_state);
+        pthread_join(ep6_id, NULL);
+        ep6_threaded = false;
+    } else if (ep6_active()) {
+        ep6_stop();
+    }
+    ep6_state = EP6_IDLE;
+}
+
+// (re)start a session; a running one is torn down first
+void ep6_request_start(void) {
+    __atomic_store_n(&ep6_request_ns, hpsdr_pipeline_now(), __ATOMIC_RELAXED);
+
+    if (!ep6_threaded) {
+        if (ep6_active())
+            ep6_stop();
+        __atomic_store_n(&ep6_state, EP6_IDLE, __ATOMIC_RELEASE);
+        if (ep6_start() == 0) {
+            __atomic_store_n(&ep6_state, EP6_RUNNING, __ATOMIC_RELEASE);
+            ep6_latency(&ep6_stats.sessions, &ep6_stats.start_max_ns, &ep6_stats.start_sum_ns);
         }
+        return;
+    }
+
+    __atomic_store_n(&ep6_state, EP6_STARTING, __ATOMIC_RELEASE);
+    hpsdr_futex_wake(&ep6_state);
+}
 
-        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &delay, NULL);
+void ep6_request_stop(void) {
+    __atomic_store_n(&ep6_request_ns, hpsdr_pipeline_now(), __ATOMIC_RELAXED);
 
-        hpsdr_network_send(buffer, 1032);
+    if (!ep6_threaded) {
+        if (!ep6_active())
+            return;
+        __atomic_store_n(&ep6_state, EP6_IDLE, __ATOMIC_RELEASE);
+        ep6_latency(&ep6_stats.stops, &ep6_stats.stop_max_ns, &ep6_stats.stop_sum_ns);
+        ep6_stop();
+        return;
     }
-    active_thread = 0;
-    seqnum = 0;
-    last_seqnum = 0xffffffff;
 
-    iqsender_clear_buffer();
+    if (ep6_move(EP6_RUNNING, EP6_STOPPING) || ep6_move(EP6_STARTING, EP6_STOPPING))
+        hpsdr_futex_wake(&ep6_state);
+}
 
-    hpsdr_dbg_printf(1, "Stop handler_ep6\n");
+bool ep6_active(void) {
+    uint32_t state = __atomic_load_n(&ep6_state, __ATOMIC_ACQUIRE);
 
-    return NULL;
+    return state == EP6_STARTING || state == EP6_RUNNING;
 }
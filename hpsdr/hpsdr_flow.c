@@ -0,0 +1,131 @@
+/*
+ * Copyright 2021 Emiliano Gonzalez LU3VEA (lu3vea @ gmail . com))
+ * * Project Site: https://github.com/hiperiondev/hpsdr-p1-rpitx *
+ *
+ * This is based on other projects:
+ *    librpitx (https://github.com/F5OEO/librpitx)
+ *    HPSDR simulator (https://github.com/g0orx/pihpsdr)
+ *    small-memory XML config database library (https://github.com/dleonard0/mxml)
+ *
+ *    please contact their authors for more information.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ *
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <math.h>
+
+#include "hpsdr_main.h"
+#include "hpsdr_ring.h"
+#include "hpsdr_iq_tx.h"
+#include "hpsdr_jitter.h"
+#include "hpsdr_flow.h"
+
+#define RATE    48000.0
+#define PERIOD  1000000000ULL  // ns between updates
+#define LOCK    5              // periods averaged before the loop closes
+#define OMEGA   0.01           // loop natural frequency, rad/s (about ten minutes)
+#define ZETA    0.7
+
+// ep6 thread only, the ring fill is the one value read from the tx side
+hpsdr_flow_stats_t flow_stats;
+
+static double fill_sum;
+static unsigned fill_count;
+static uint64_t last;      // time of the last update, 0: none yet
+static double integral;    // drift estimate, as a ratio offset
+static unsigned locking;
+
+// start over: no offset, a new setpoint after LOCK periods
+void hpsdr_flow_reset(void) {
+    fill_sum = 0.0;
+    fill_count = 0;
+    last = 0;
+    locking = LOCK;
+    integral = 0.0;
+    flow_stats.ppm = 0.0;
+    flow_stats.drift = 0.0;
+    flow_stats.error = 0.0;
+    ++flow_stats.locks;
+}
+
+// tx ring fill seen when an ep6 batch is built
+void hpsdr_flow_sample(uint32_t fill) {
+    // head and tail are read apart, a consumer in between can make the difference wrap
+    if (fill > iq_ring.size)
+        return;
+
+    fill_sum += fill;
+    fill_count++;
+}
+
+// once per PERIOD: PI loop from the averaged fill to the ep6 rate offset, returns 1 if it changed
+int hpsdr_flow_update(uint64_t now) {
+    const double kp = 2.0 * ZETA * OMEGA / RATE, ki = OMEGA * OMEGA / RATE, max = config.global.flowppm * 1e-6;
+    double dt, u;
+
+    if (last == 0) {
+        last = now;
+        return 0;
+    }
+    if (now - last < PERIOD)
+        return 0;
+    dt = (now - last) / 1e9;
+    last = now;
+
+    if (fill_count == 0)
+        return 0;
+    flow_stats.fill = fill_sum / fill_count;
+    fill_sum = 0.0;
+    fill_count = 0;
+
+    // no tx samples coming in: nothing to steer, lock again once they are
+    if (flow_stats.fill < 1.0) {
+        if (locking == LOCK && flow_stats.ppm == 0.0)
+            return 0;
+        hpsdr_flow_reset();
+        return 1;
+    }
+
+    if (locking > 0) {
+        flow_stats.setpoint = locking == LOCK ? flow_stats.fill : flow_stats.setpoint + (flow_stats.fill - flow_stats.setpoint) / (LOCK - locking + 1);
+        --locking;
+        return 0;
+    }
+    if (config.tx.jitterbuffer)
+        flow_stats.setpoint = hpsdr_jitter_target();
+
+    // the host sends at the rate we pace ep6 at, so the fill moves at RATE * (u - drift):
+    // a full ring slows ep6 down; kp and ki put the closed loop poles at OMEGA, ZETA
+    flow_stats.error = flow_stats.fill - flow_stats.setpoint;
+    integral -= ki * flow_stats.error * dt;
+    if (fabs(integral) > max)
+        integral = copysign(max, integral);
+
+    u = integral - kp * flow_stats.error;
+    if (fabs(u) >= max) {
+        u = copysign(max, u);
+        ++flow_stats.clamped;
+    }
+
+    flow_stats.ppm = u * 1e6;
+    flow_stats.drift = integral * 1e6;
+    ++flow_stats.updates;
+
+    return 1;
+}
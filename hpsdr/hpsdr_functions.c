@@ -33,7 +33,7 @@
 #include "hpsdr_debug.h"
 #include "hpsdr_definitions.h"
 #include "hpsdr_main.h"
-#include "hpsdr_iq_tx.h"
+#include "hpsdr_control.h"
 
 // special functions
 void hpsdr_erase_packet(uint8_t *buffer) {
@@ -384,7 +384,8 @@ void ep2_txdrive(uint8_t *frame, int *reg, int val, char *str) {
 
 void ep2_txfreq(uint8_t *frame, long *reg, int val, char *str) {
     *reg = val;
-    iqsender_set();
+    // retuning may take a while: never on the receive path
+    hpsdr_control_retune();
     hpsdr_dbg_printf(1, "%24s= %08lx (%10ld)\n", str, (long) val, (long) *reg);
 }
 
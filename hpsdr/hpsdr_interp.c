@@ -0,0 +1,160 @@
+/*
+ * Copyright 2021 Emiliano Gonzalez LU3VEA (lu3vea @ gmail . com))
+ * * Project Site: https://github.com/hiperiondev/hpsdr-p1-rpitx *
+ *
+ * This is based on other projects:
+ *    librpitx (https://github.com/F5OEO/librpitx)
+ *    HPSDR simulator (https://github.com/g0orx/pihpsdr)
+ *    small-memory XML config database library (https://github.com/dleonard0/mxml)
+ *
+ *    please contact their authors for more information.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ *
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <complex.h>
+#include <time.h>
+
+#include "hpsdr_debug.h"
+#include "hpsdr_interp.h"
+
+#define CUTOFF 21600.0  // Hz, passband edge of the 48 kHz input
+#define RATE   48000.0
+
+static uint64_t interp_now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// blackman-harris windowed sinc, split in phases with unity dc gain each
+static void interp_design(hpsdr_interp_t *f) {
+    unsigned len = f->factor * f->taps;
+    double fc = CUTOFF / (RATE * f->factor), mid = (len - 1) / 2.0;
+
+    for (unsigned p = 0; p < f->factor; p++) {
+        double sum = 0.0;
+
+        for (unsigned k = 0; k < f->taps; k++) {
+            unsigned i = p + k * f->factor;
+            double x = i - mid, w = 2.0 * M_PI * i / (len - 1);
+            double h = x == 0.0 ? 2.0 * fc : sin(2.0 * M_PI * fc * x) / (M_PI * x);
+
+            h *= 0.35875 - 0.48829 * cos(w) + 0.14128 * cos(2.0 * w) - 0.01168 * cos(3.0 * w);
+            f->coef[p * f->taps + k] = h;
+            sum += h;
+        }
+        for (unsigned k = 0; k < f->taps; k++)
+            f->coef[p * f->taps + k] /= sum;
+    }
+}
+
+int hpsdr_interp_init(hpsdr_interp_t *f, unsigned factor, unsigned taps, unsigned block) {
+    memset(f, 0, sizeof(*f));
+    f->factor = factor;
+    f->taps = taps;
+    f->block = block;
+    f->coef = malloc(factor * taps * sizeof(float));
+    f->hist = calloc(taps - 1 + block, sizeof(float _Complex));
+    f->acc = malloc(2 * block * sizeof(float));
+    if (f->coef == NULL || f->hist == NULL || f->acc == NULL) {
+        hpsdr_interp_deinit(f);
+        return -1;
+    }
+    interp_design(f);
+
+    return 0;
+}
+
+void hpsdr_interp_deinit(hpsdr_interp_t *f) {
+    free(f->coef);
+    free(f->hist);
+    free(f->acc);
+    f->coef = NULL;
+    f->hist = NULL;
+    f->acc = NULL;
+}
+
+// block input samples to factor * block output samples
+void hpsdr_interp_run(hpsdr_interp_t *f, const float _Complex *in, float _Complex *out) {
+    const unsigned n2 = 2 * f->block;
+    const float *x = (const float*) f->hist;
+    float *y = (float*) out;
+    uint64_t start = interp_now(), busy;
+
+    memcpy(f->hist + f->taps - 1, in, f->block * sizeof(float _Complex));
+
+    // one phase at a time: a tap is a scaled add over the whole block, which the compiler vectorizes
+    for (unsigned p = 0; p < f->factor; p++) {
+        const float *c = f->coef + p * f->taps;
+
+        memset(f->acc, 0, n2 * sizeof(float));
+        for (unsigned k = 0; k < f->taps; k++) {
+            const float *xk = x + 2 * (f->taps - 1 - k);
+            const float ck = c[k];
+
+            for (unsigned j = 0; j < n2; j++)
+                f->acc[j] += ck * xk[j];
+        }
+        for (unsigned j = 0; j < f->block; j++) {
+            y[2 * (j * f->factor + p)] = f->acc[2 * j];
+            y[2 * (j * f->factor + p) + 1] = f->acc[2 * j + 1];
+        }
+    }
+
+    memmove(f->hist, f->hist + f->block, (f->taps - 1) * sizeof(float _Complex));
+
+    busy = interp_now() - start;
+    f->runs++;
+    f->busy_ns += busy;
+    if (busy > f->busy_max_ns)
+        f->busy_max_ns = busy;
+}
+
+// cost of every factor on this board, as a share of the real time one block of output covers
+void hpsdr_interp_bench(unsigned taps, unsigned block) {
+    float _Complex *in = malloc(block * sizeof(float _Complex));
+    float _Complex *out = malloc(INTERP_MAX_FACTOR * block * sizeof(float _Complex));
+    double budget = block * 1e9 / RATE;
+    hpsdr_interp_t f;
+
+    if (in == NULL || out == NULL)
+        goto end;
+
+    for (unsigned n = 0; n < block; n++)
+        in[n] = cexpf(I * 0.1f * n);
+
+    hpsdr_dbg_printf(1, "interpolation benchmark (%u taps/phase, %u samples/block, %.1f ms budget):\n", taps, block, budget / 1e6);
+    for (unsigned factor = 2; factor <= INTERP_MAX_FACTOR; factor *= 2) {
+        if (hpsdr_interp_init(&f, factor, taps, block) < 0)
+            break;
+        for (int r = 0; r < 20; r++)
+            hpsdr_interp_run(&f, in, out);
+        hpsdr_dbg_printf(1, "  %ux: %8.1f us/block avg, %8.1f max (%5.1f%% cpu)\n", factor, f.busy_ns / (1e3 * f.runs), f.busy_max_ns / 1e3,
+                100.0 * f.busy_ns / f.runs / budget);
+        hpsdr_interp_deinit(&f);
+    }
+
+end:
+    free(in);
+    free(out);
+}
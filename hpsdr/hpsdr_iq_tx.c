@@ -27,9 +27,12 @@
  */
 
 #include <stdbool.h>
+#include <stdlib.h>
 #include <complex.h>
+#include <math.h>
 #include <unistd.h>
 #include <string.h>
+#include <time.h>
 #include <pthread.h>
 
 #include "hpsdr_debug.h"
@@ -37,46 +40,125 @@
 #include "hpsdr_main.h"
 #include "hpsdr_protocol.h"
 #include "hpsdr_config.h"
-
-#include "librpitx.h"
-
-#define Harmonic 1
+#include "hpsdr_pipeline.h"
+#include "hpsdr_ring.h"
+#include "hpsdr_convert.h"
+#include "hpsdr_jitter.h"
+#include "hpsdr_resample.h"
+#include "hpsdr_interp.h"
+#include "hpsdr_futex.h"
+#include "hpsdr_dma.h"
+#define TX_RAMP  96  // samples (2 ms) of fade out/in around an underrun
+#define TX_GRACE 2   // blocks the dma fifo may go without a new one before silence is fed
 
          int band;
         bool tx_init = false;
         bool sender_init = false;
         bool tx_sending = false;
-unsigned int tx_block = 0;
  static long last_freq = 0;
+ static long tx_center = 0;     // carrier the dma was initialised on
+ static long tx_offset = 0;     // last_freq - tx_center, applied by the nco
+ static float _Complex nco_phase = 1.0f;
+ static bool tx_flush = false;  // set by iqsender_clear_buffer, serviced by the feeder
+ static int16_t *tx_block16 = NULL;  // compact ring: one block before conversion
+ static bool tx_prebuffer = true;    // jitter buffer: refilling up to its target
+ static unsigned tx_trim = 0;        // jitter buffer: samples the next block crossfades over
+ static float _Complex tx_trim_next[JITTER_SHRINK];  // the samples following that block
+ static float _Complex *tx_in = NULL;  // resampler input, up to a block plus RESAMPLE_SLACK(block)
+ static float _Complex *tx_out = NULL; // interpolated block, iqburst * interpolation samples
+ static bool tx_underrun = true;     // feeding silence, the next real block fades in
+ static uint64_t tx_due = 0;         // a block has to go to the dma by then
+ static float _Complex tx_last = 0;  // last sample handed over, the fade out starts from it
+ static uint32_t tx_gen = 0;         // bumped when tx comes up, the idle feeder sleeps on it
    pthread_t iqsender_tx_id;
 
+hpsdr_ring_t iq_ring;
+hpsdr_interp_t tx_interp;
+hpsdr_tx_stats_t tx_stats;
+
+// ring between samples_rcv and the dma feeder plus the block handed to the dma
+int iqsender_buffer_init(void) {
+    size_t elem = config.tx.compact ? 2 * sizeof(int16_t) : sizeof(float _Complex);
+
+    if (hpsdr_ring_init(&iq_ring, TXLEN * config.global.iqburst, elem) < 0) {
+        hpsdr_dbg_printf(0, "ERROR: can't allocate tx ring\n");
+        return -1;
+    }
+
+    tx_arg.iq_buffer = (float _Complex*) malloc(config.global.iqburst * sizeof(float _Complex));
+    if (config.tx.compact)
+        tx_block16 = (int16_t*) malloc((config.global.iqburst + RESAMPLE_SLACK(config.global.iqburst)) * elem);
+    if (config.tx.resample)
+        tx_in = (float _Complex*) malloc((config.global.iqburst + RESAMPLE_SLACK(config.global.iqburst)) * sizeof(float _Complex));
+    if (config.tx.interpolation > 1) {
+        tx_out = (float _Complex*) malloc(config.global.iqburst * config.tx.interpolation * sizeof(float _Complex));
+        if (hpsdr_interp_init(&tx_interp, config.tx.interpolation, config.tx.taps, config.global.iqburst) < 0)
+            tx_out = NULL;
+        else if (config.global.bench)
+            hpsdr_interp_bench(config.tx.taps, config.global.iqburst);
+    }
+    if (tx_arg.iq_buffer == NULL || (config.tx.compact && tx_block16 == NULL) || (config.tx.resample && tx_in == NULL)
+            || (config.tx.interpolation > 1 && tx_out == NULL)) {
+        hpsdr_dbg_printf(0, "ERROR: can't allocate tx buffer\n");
+        hpsdr_ring_deinit(&iq_ring);
+        return -1;
+    }
+    hpsdr_jitter_init(config.global.iqburst, iq_ring.size);
+    hpsdr_resample_reset();
+    hpsdr_dma_select(config.tx.dma);
+
+    return 0;
+}
+
+// producer side (samples_rcv): nothing is queued before there is a dma to drain it
+void iqsender_write(const float _Complex *samples, unsigned len) {
+    if (!tx_init)
+        return;
+
+    if (config.tx.jitterbuffer)
+        hpsdr_jitter_arrival(hpsdr_pipeline_now(), len);
+    hpsdr_ring_write(&iq_ring, samples, len);
+}
+
+// same for the compact ring, len I/Q pairs
+void iqsender_write16(const int16_t *samples, unsigned len) {
+    if (!tx_init)
+        return;
+
+    if (config.tx.jitterbuffer)
+        hpsdr_jitter_arrival(hpsdr_pipeline_now(), len);
+    hpsdr_ring_write(&iq_ring, samples, len);
+}
+
 void iqsender_init(uint64_t TuneFrequency) {
     if (sender_init || (TuneFrequency < 1000)) {
         printf("avoid init!\n");
         return;
     }
 
-    float ppmpll = 0.0;
-
-    iqdmasync_init(&(tx_arg.iqsender), TuneFrequency, 48000, 14, config.global.iqburst * 4, MODE_IQ);
-    iqdmasync_set_ppm(&(tx_arg.iqsender), ppmpll);
+    // the fifo keeps the same duration whatever the interpolation
+    if (dma->init(TuneFrequency, 48000 * config.tx.interpolation, config.global.iqburst * 4 * config.tx.interpolation) < 0) {
+        hpsdr_dbg_printf(0, "ERROR: %s dma init failed\n", dma->name);
+        return;
+    }
 
+    tx_center = TuneFrequency;
+    __atomic_store_n(&tx_offset, 0, __ATOMIC_RELEASE);
+    nco_phase = 1.0f;
     tx_init = true;
+    __atomic_add_fetch(&tx_gen, 1, __ATOMIC_RELEASE);
+    hpsdr_futex_wake(&tx_gen);
 
-    hpsdr_dbg_printf(0, "Start rpitx iq send\n");
+    hpsdr_dbg_printf(0, "Start %s iq send\n", dma->name);
 }
 
 void iqsender_deinit(void) {
-    if (tx_arg.iqsender != NULL) {
-        hpsdr_dbg_printf(0, "iqsender_deinit\n");
-        tx_init = false;
-        usleep(50000);
-        iqdmasync_deinit(&(tx_arg.iqsender));
-    } else {
-        hpsdr_dbg_printf(0, "ERROR: iqsender NULL\n");
-    }
+    hpsdr_dbg_printf(0, "iqsender_deinit\n");
+    tx_init = false;
+    usleep(50000);
+    dma->deinit();
 
-    hpsdr_dbg_printf(0, "Stop rpitx iq send\n");
+    hpsdr_dbg_printf(0, "Stop %s iq send\n", dma->name);
 }
 
 void iqsender_set(void) {
@@ -101,42 +183,257 @@ void iqsender_set(void) {
             return;
         }
 
-        band = hpsdr_config_get_band(settings.tx_freq);
+        int new_band = hpsdr_config_get_band(settings.tx_freq);
+        long offset = settings.tx_freq - tx_center;
+
+        // fast path: stay on the running carrier and shift the samples, the dma never stops
+        if (new_band == band && labs(offset) <= config.tx.retunewindow) {
+            __atomic_store_n(&tx_offset, offset, __ATOMIC_RELEASE);
+            ++tx_stats.fast_retunes;
+            hpsdr_dbg_printf(1, "TX frequency moved: %ld->%ld (%+ld Hz from carrier)\n", last_freq, settings.tx_freq, offset);
+            last_freq = settings.tx_freq;
+            return;
+        }
+
+        band = new_band;
         hpsdr_dbg_printf(0, "Changing TX frequency\n");
         hpsdr_dbg_printf(1, "Band: %s\n", band == -1?"out of band":config.bands[band].name);
-        iqsender_deinit();
-        iqsender_init(settings.tx_freq);
+        if (dma->set_frequency(settings.tx_freq) == 0) {
+            // the backend retuned in place
+            tx_center = settings.tx_freq;
+            __atomic_store_n(&tx_offset, 0, __ATOMIC_RELEASE);
+            ++tx_stats.backend_retunes;
+        } else {
+            iqsender_deinit();
+            iqsender_init(settings.tx_freq);
+            ++tx_stats.full_retunes;
+        }
 
         hpsdr_dbg_printf(0, "TX frequency changed: %d->%d\n", last_freq, settings.tx_freq);
         last_freq = settings.tx_freq;
     }
 }
 
+// mix one block in place by the retune offset, the phase carries over between blocks
+static void iqsender_nco(float _Complex *samples, int len, long offset) {
+    float _Complex step = cexpf(I * (float) (2.0 * M_PI * offset / 48000.0));
+    float _Complex phase = nco_phase;
+
+    for (int n = 0; n < len; n++) {
+        samples[n] *= phase;
+        phase *= step;
+    }
+
+    // keep rounding errors from growing the amplitude
+    nco_phase = phase / cabsf(phase);
+}
+
+// hold the feeder back until the ring is at the jitter target again after running dry
+static bool iqsender_jitter(void) {
+    unsigned fill = hpsdr_ring_fill(&iq_ring);
+
+    if (tx_prebuffer) {
+        if (fill < hpsdr_jitter_target())
+            return false;
+        tx_prebuffer = false;
+    } else if (fill < config.global.iqburst) {
+        // not there yet, iqsender_conceal decides if it is an underrun
+        return false;
+    }
+
+    // the resampler drains down to the target by itself, without it the next block drops the excess
+    tx_trim = hpsdr_jitter_fill(fill, !config.tx.resample);
+    return true;
+}
+
+// drop trim samples without a splice: the start of the block fades into the stream trim samples later
+static void iqsender_trim(float _Complex *buf, unsigned len, const float _Complex *next, unsigned trim) {
+    for (unsigned i = 0; i < len; i++) {
+        float _Complex later = i + trim < len ? buf[i + trim] : next[i + trim - len];
+
+        buf[i] = i < TX_RAMP ? buf[i] + (later - buf[i]) * ((float) i / TX_RAMP) : later;
+    }
+}
+
+// samples the feeder has to wait for before the next block can go out
+unsigned iqsender_tx_want(void) {
+    if (config.tx.jitterbuffer && tx_prebuffer)
+        return hpsdr_jitter_target();
+
+    return config.tx.resample ? hpsdr_resample_need(config.global.iqburst) : config.global.iqburst;
+}
+
+// len samples from the ring as float, all or nothing
+static bool iqsender_read(float _Complex *dst, unsigned len) {
+    uint64_t start;
+
+    if (!config.tx.compact)
+        return hpsdr_ring_read(&iq_ring, dst, len) != 0;
+
+    if (hpsdr_ring_read(&iq_ring, tx_block16, len) == 0)
+        return false;
+
+    start = hpsdr_pipeline_now();
+    hpsdr_convert_s16(tx_block16, dst, len);
+    tx_stats.out_convert_ns += hpsdr_pipeline_now() - start;
+    tx_stats.out_samples += len;
+
+    return true;
+}
+
+// drop whatever is queued, done by the feeder as it owns the read side of the ring
 void iqsender_clear_buffer(void) {
-    memset(tx_arg.iq_buffer, 0, config.global.iqburst * TXLEN * sizeof(float _Complex));
+    __atomic_store_n(&tx_flush, true, __ATOMIC_RELEASE);
+    hpsdr_ring_wake(&iq_ring);
+}
+
+// time (in nanosecs) the dma needs for one block of iqburst samples
+long iqsender_block_time(void) {
+    return (long) config.global.iqburst * 1000000000L / 48000;
+}
+
+// next block from the ring into tx_arg.iq_buffer: only whole blocks of samples that have arrived
+static bool iqsender_fetch(void) {
+    unsigned fill;
+
+    if (config.tx.jitterbuffer && !iqsender_jitter())
+        return false;
+
+    if (config.tx.resample) {
+        // the fill before the read drives the rate of the following blocks
+        fill = hpsdr_ring_fill(&iq_ring);
+        if (!iqsender_read(tx_in, hpsdr_resample_need(config.global.iqburst)))
+            return false;
+        hpsdr_resample_run(tx_in, tx_arg.iq_buffer, config.global.iqburst);
+        hpsdr_resample_control(fill, config.tx.jitterbuffer ? hpsdr_jitter_target() : 0, config.global.iqburst);
+        return true;
+    }
+
+    if (!iqsender_read(tx_arg.iq_buffer, config.global.iqburst))
+        return false;
+    // the trim only asks for samples beyond the target, they are queued already
+    if (tx_trim > 0 && iqsender_read(tx_trim_next, tx_trim))
+        iqsender_trim(tx_arg.iq_buffer, config.global.iqburst, tx_trim_next, tx_trim);
+    tx_trim = 0;
+    return true;
+}
+
+// no block in time: play what is queued, fade from the last sample to zero, then silence
+static void iqsender_conceal(void) {
+    unsigned n = 0, len = config.global.iqburst;
+    float _Complex *buf = tx_arg.iq_buffer;
+
+    if (!tx_underrun) {
+        n = hpsdr_ring_fill(&iq_ring);
+        if (n > len)
+            n = len;
+        if (n > 0 && iqsender_read(buf, n)) {
+            tx_stats.recovered += n;
+            tx_last = buf[n - 1];
+        } else
+            n = 0;
+
+        ++tx_stats.underruns;
+        tx_underrun = true;
+        tx_prebuffer = true;
+        if (config.tx.jitterbuffer)
+            hpsdr_jitter_underrun();
+        hpsdr_resample_reset();
+    }
+
+    for (unsigned i = n; i < len; i++)
+        buf[i] = i - n < TX_RAMP ? tx_last * ((float) (TX_RAMP - (i - n)) / TX_RAMP) : 0.0f;
+    tx_last = 0.0f;
+    tx_stats.concealed += len - n;
+}
+
+// hand one block to the dma, false if there is no tx to feed or nothing due yet
+bool iqsender_tx_block(void) {
+    long offset;
+    uint64_t start;
+
+    if (!tx_init)
+        return false;
+
+    if (__atomic_exchange_n(&tx_flush, false, __ATOMIC_ACQ_REL)) {
+        hpsdr_ring_discard(&iq_ring);
+        hpsdr_resample_reset();
+        tx_prebuffer = true;
+        tx_underrun = true;
+        tx_last = 0.0f;
+    }
+
+    if (iqsender_fetch()) {
+        if (tx_underrun) {
+            for (unsigned i = 0; i < TX_RAMP && i < (unsigned) config.global.iqburst; i++)
+                tx_arg.iq_buffer[i] *= (float) i / TX_RAMP;
+            tx_underrun = false;
+        }
+        tx_last = tx_arg.iq_buffer[config.global.iqburst - 1];
+    } else {
+        // the dma never replays old samples: silence goes out once a block is due
+        if (hpsdr_pipeline_now() < tx_due)
+            return false;
+        iqsender_conceal();
+    }
+
+    // includes the time spent waiting for room in the dma fifo
+    start = hpsdr_pipeline_now();
+    offset = __atomic_load_n(&tx_offset, __ATOMIC_ACQUIRE);
+    // back on the carrier the held phase stays applied, dropping it would be a phase step
+    if (offset != 0 || nco_phase != 1.0f)
+        iqsender_nco(tx_arg.iq_buffer, config.global.iqburst, offset);
+    if (config.tx.interpolation > 1) {
+        hpsdr_interp_run(&tx_interp, tx_arg.iq_buffer, tx_out);
+        dma->push(tx_out, config.global.iqburst * config.tx.interpolation);
+    } else
+        dma->push(tx_arg.iq_buffer, config.global.iqburst);
+    hpsdr_pipeline_account(STAGE_TX, start, 1);
+    // silence keeps the fifo full at the dma pace, real data gets TX_GRACE blocks to arrive
+    tx_due = tx_underrun ? 0 : hpsdr_pipeline_now() + TX_GRACE * iqsender_block_time();
+
+    return true;
+}
+
+// ms the feeder may sleep before a block is due
+int iqsender_tx_timeout(void) {
+    int64_t left = (int64_t) (tx_due - hpsdr_pipeline_now());
+
+    if (left <= 0)
+        return 1;
+
+    return left / 1000000 < 100 ? left / 1000000 + 1 : 100;
 }
 
 void* iqsender_tx(void *data) {
+    struct timespec cpu;
+
     hpsdr_dbg_printf(0, "START SENDER THREAD\n");
-    int buffer_offset = 0;
 
     if (tx_arg.iq_buffer == NULL) {
         hpsdr_dbg_printf(0, "ERROR: tx buffer not allocated\n");
         return NULL;
     }
 
+    hpsdr_pipeline_pin(STAGE_TX);
+
     while (1) {
-        if (tx_arg.iqsender == NULL || !tx_init) {
-            usleep(100);
+        if (iqsender_tx_block())
             continue;
-        }
 
-        buffer_offset = tx_block * config.global.iqburst;
-        iqdmasync_set_iq_samples(&(tx_arg.iqsender), tx_arg.iq_buffer + buffer_offset, config.global.iqburst, Harmonic);
+        if (__atomic_load_n(&tx_init, __ATOMIC_ACQUIRE)) {
+            hpsdr_ring_wait(&iq_ring, iqsender_tx_want(), iqsender_tx_timeout());
+        } else {
+            // no tx: sleep until iqsender_init, the generation is read first so a start in between is not missed
+            uint32_t gen = __atomic_load_n(&tx_gen, __ATOMIC_ACQUIRE);
 
-        ++tx_block;
-        if (tx_block > TXLEN - 1)
-            tx_block = 0;
+            if (!__atomic_load_n(&tx_init, __ATOMIC_ACQUIRE))
+                hpsdr_futex_wait(&tx_gen, gen, -1);
+            ++tx_stats.idle_wakeups;
+        }
+        ++tx_stats.wakeups;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu);
+        tx_stats.cpu_ns = (uint64_t) cpu.tv_sec * 1000000000ULL + cpu.tv_nsec;
     }
 
     hpsdr_dbg_printf(0, "STOP SENDER THREAD\n");
@@ -0,0 +1,167 @@
+/*
+ * Copyright 2021 Emiliano Gonzalez LU3VEA (lu3vea @ gmail . com))
+ * * Project Site: https://github.com/hiperiondev/hpsdr-p1-rpitx *
+ *
+ * This is based on other projects:
+ *    librpitx (https://github.com/F5OEO/librpitx)
+ *    HPSDR simulator (https://github.com/g0orx/pihpsdr)
+ *    small-memory XML config database library (https://github.com/dleonard0/mxml)
+ *
+ *    please contact their authors for more information.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ *
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "hpsdr_main.h"
+#include "hpsdr_jitter.h"
+
+#define RATE       48000                       // ep2 tx samples per second
+#define GAP_NS     500000000LL                 // a later packet restarts the arrival clock
+#define WINDOW_NS  1000000000LL                // percentile / trim period
+
+hpsdr_jitter_stats_t jitter_stats;
+
+// read only after init
+static unsigned jb_block;     // samples the feeder hands to the dma at once
+static unsigned jb_max;       // target cap, samples
+
+// producer side (samples_rcv)
+static  int64_t arr_base;     // arrival time of sample 0 of the current clock
+static uint64_t arr_samples;  // samples received since arr_base
+static  int64_t arr_min;      // earliest lateness in this window
+static  int64_t arr_window;   // end of this window
+static uint32_t hist[JITTER_BINS];
+static uint32_t hist_total;
+
+// consumer side (feeder)
+static unsigned fill_min = UINT32_MAX;
+static unsigned blocks;
+static     bool grown;        // an underrun happened in this window
+
+void hpsdr_jitter_init(unsigned block, unsigned capacity) {
+    unsigned max = block + config.tx.jittermax * (RATE / 1000);
+
+    jb_block = block;
+    // one packet of headroom so the producer never overruns at the target
+    jb_max = max < capacity - 126 ? max : capacity - 126;
+    memset(&jitter_stats, 0, sizeof(jitter_stats));
+    jitter_stats.target = jb_block;
+}
+
+static void jitter_update_target(void) {
+    uint32_t ms = jitter_stats.jitter_ms > jitter_stats.floor_ms ? jitter_stats.jitter_ms : jitter_stats.floor_ms;
+    unsigned target = jb_block + ms * (RATE / 1000);
+
+    __atomic_store_n(&jitter_stats.target, target < jb_max ? target : jb_max, __ATOMIC_RELAXED);
+}
+
+// lateness of the packet against a steady 48 kHz clock anchored on the earliest arrival
+void hpsdr_jitter_arrival(uint64_t now, unsigned samples) {
+    int64_t late = (int64_t) now - arr_base - (int64_t) (arr_samples * 1000000000ULL / RATE);
+    uint32_t bin;
+
+    if (arr_samples == 0 || late > GAP_NS) {
+        if (arr_samples != 0)
+            ++jitter_stats.resyncs;
+        arr_base = now;
+        arr_samples = 0;
+        arr_min = INT64_MAX;
+        arr_window = now + WINDOW_NS;
+        late = 0;
+    } else if (late < 0) {
+        // earlier than ever: the clock was anchored on a late packet
+        arr_base += late;
+        late = 0;
+    }
+    arr_samples += samples;
+    if (late < arr_min)
+        arr_min = late;
+
+    bin = late / 1000000;
+    hist[bin < JITTER_BINS ? bin : JITTER_BINS - 1]++;
+    hist_total++;
+
+    if ((int64_t) now < arr_window)
+        return;
+
+    // percentile of the (decaying) histogram
+    uint32_t want = (uint64_t) hist_total * config.tx.jitterpercentile / 100, sum = 0;
+    for (bin = 0; bin < JITTER_BINS - 1; bin++) {
+        sum += hist[bin];
+        if (sum >= want)
+            break;
+    }
+    __atomic_store_n(&jitter_stats.jitter_ms, bin + 1, __ATOMIC_RELAXED);
+
+    // halve the history so the estimate follows the link, re-anchor to cancel clock drift
+    hist_total = 0;
+    for (bin = 0; bin < JITTER_BINS; bin++) {
+        hist[bin] >>= 1;
+        hist_total += hist[bin];
+    }
+    arr_base += arr_min;
+    arr_min = INT64_MAX;
+    arr_window = now + WINDOW_NS;
+
+    jitter_update_target();
+}
+
+// samples the feeder waits for before it resumes after an underrun
+unsigned hpsdr_jitter_target(void) {
+    return __atomic_load_n(&jitter_stats.target, __ATOMIC_RELAXED);
+}
+
+void hpsdr_jitter_underrun(void) {
+    ++jitter_stats.underruns;
+    grown = true;
+    if (jitter_stats.floor_ms < config.tx.jittermax)
+        __atomic_store_n(&jitter_stats.floor_ms, jitter_stats.floor_ms + JITTER_GROW_MS, __ATOMIC_RELAXED);
+    jitter_update_target();
+}
+
+// fill seen before each block, returns how many samples to drop to come back to the target;
+// no trim if the caller drains the excess itself
+unsigned hpsdr_jitter_fill(unsigned fill, bool trim_ok) {
+    unsigned trim = 0, target;
+
+    if (fill < fill_min)
+        fill_min = fill;
+
+    if (++blocks < RATE / jb_block)
+        return 0;
+
+    // once a second: decay the underrun floor and trim what the link no longer needs
+    target = hpsdr_jitter_target();
+    if (!grown) {
+        if (jitter_stats.floor_ms > 0)
+            __atomic_store_n(&jitter_stats.floor_ms, jitter_stats.floor_ms - 1, __ATOMIC_RELAXED);
+        if (trim_ok && fill_min > target + JITTER_SHRINK)
+            trim = JITTER_SHRINK;
+    }
+    jitter_stats.trimmed += trim;
+    jitter_update_target();
+
+    blocks = 0;
+    fill_min = UINT32_MAX;
+    grown = false;
+
+    return trim;
+}
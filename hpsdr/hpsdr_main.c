@@ -51,13 +51,18 @@
 #include "hpsdr_functions.h"
 #include "hpsdr_definitions.h"
 #include "hpsdr_iq_tx.h"
+#include "hpsdr_convert.h"
 #include "hpsdr_network.h"
 #include "hpsdr_config.h"
 #include "hpsdr_version.h"
+#include "hpsdr_stats.h"
+#include "hpsdr_pipeline.h"
+#include "hpsdr_ep6.h"
+#include "hpsdr_control.h"
+#include "hpsdr_rx.h"
+#include "hpsdr_pack.h"
 
 int device_emulation;
-int enable_thread;
-int active_thread;
 double c1, c2;
 hpsdr_config_t config;
 
@@ -97,6 +102,10 @@ char exit_signal[33][17] = {
         "SIGSYS/SIGUNUSED",
 };
 
+static void request_stats(int num) {
+    stats_request = 1;
+}
+
 static void terminate(int num) {
     fprintf(stderr, "Caught signal - Terminating 0x%x/%d(%s)\n", num, num, exit_signal[num]);
     iqsender_deinit();
@@ -113,7 +122,7 @@ int main(int argc, char *argv[]) {
         struct sigaction sa;
 
         memset(&sa, 0, sizeof(sa));
-        sa.sa_handler = terminate;
+        sa.sa_handler = (i == SIGUSR1) ? request_stats : terminate;
         sigaction(i, &sa, NULL);
     }
 
@@ -191,18 +200,35 @@ int main(int argc, char *argv[]) {
             break;
     }
 
-    tx_arg.iq_buffer = (float _Complex*) malloc(config.global.iqburst * TXLEN * sizeof(float _Complex));
+    if (iqsender_buffer_init() < 0)
+        exit(1);
+    hpsdr_convert_init();
+    hpsdr_pack_init();
     tx_arg.iqsender = NULL;
 
-    pthread_create(&iqsender_tx_id, NULL, &iqsender_tx, (void*) &tx_arg);
-    pthread_detach(iqsender_tx_id);
+    // in single run mode the network loop feeds the dma itself
+    if (config.global.runmode == RUN_THREADED) {
+        pthread_create(&iqsender_tx_id, NULL, &iqsender_tx, (void*) &tx_arg);
+        pthread_detach(iqsender_tx_id);
+    }
+
+    if (hpsdr_rx_init() < 0 || hpsdr_control_init() < 0 || hpsdr_pipeline_init() < 0 || ep6_init() < 0)
+        exit(1);
 
     hpsdr_network_init();
     while (1) {
         if (hpsdr_network_process() != EXIT_SUCCESS)
             break;
+        if (stats_request) {
+            stats_request = 0;
+            hpsdr_stats_print();
+        }
     }
+    ep6_deinit();
     hpsdr_network_deinit();
+    hpsdr_pipeline_deinit();
+    hpsdr_control_deinit();
+    hpsdr_rx_deinit();
 
     return EXIT_SUCCESS;
 }
@@ -26,12 +26,17 @@
  *
  */
 
+#define _GNU_SOURCE
 #include <stdlib.h>
 #include <string.h>
 #include <sys/ioctl.h>
 #include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <poll.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
+#include <netinet/udp.h>
 #include <fcntl.h>
 #include <errno.h>
 #include <unistd.h>
@@ -41,28 +46,83 @@
 #include "hpsdr_definitions.h"
 #include "hpsdr_main.h"
 #include "hpsdr_functions.h"
-#include "hpsdr_ep2.h"
 #include "hpsdr_ep6.h"
-#include "hpsdr_tx_samples.h"
+#include "hpsdr_iq_tx.h"
 #include "hpsdr_protocol.h"
+#include "hpsdr_network.h"
+#include "hpsdr_stats.h"
+#include "hpsdr_uring.h"
+#include "hpsdr_pool.h"
+#include "hpsdr_pipeline.h"
+#include "hpsdr_control.h"
+
+#ifndef UDP_GRO
+#define UDP_GRO 104
+#endif
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+
+#define RX_BATCH_MAX 64     // upper limit for config.global.rxbatch
+#define RX_FRAME_LEN 1032   // largest protocol 1 datagram
+#define RX_GRO_LEN   65536  // largest coalesced gro datagram
+#define TX_BATCH_MAX 32     // upper limit for config.global.txbatch
+#define TX_FRAME_LEN 1032   // ep6 frame
+#define EV_MAX       8      // epoll events per wakeup
+#define URING_BUFS   64     // provided receive buffers (power of two)
+#define URING_BGID   0      // their buffer group
+#define CATCHUP_MAX  4      // late ep6 batches sent back to back per timer event in single run mode
 
-         pthread_t op_handler_ep6_id;
                int sock_TCP_Server;
                int sock_TCP_Client;
                int sock_udp;
 struct sockaddr_in addr;
 struct sockaddr_in addr_udp;
-         socklen_t lenaddr;
 struct sockaddr_in addr_from;
-    struct timeval tv;
-           uint8_t buffer[1032];
                int yes = 1;
-               int bytes_read, bytes_left;
+               int bytes_read;
                int size;
           uint32_t last_seqnum = 0xffffffff, seqnum;  // sequence number of received packet
-               int udp_retries = 0;
           uint32_t code;
-          uint32_t *code0 = (uint32_t*) buffer;  // fast access to code of first buffer
+
+// batched udp reception
+static struct mmsghdr rx_msgs[RX_BATCH_MAX];
+static struct iovec rx_iov[RX_BATCH_MAX];
+static struct sockaddr_in rx_from[RX_BATCH_MAX];
+static uint8_t rx_cmsg[RX_BATCH_MAX][CMSG_SPACE(sizeof(int))];
+static int rx_slot[RX_BATCH_MAX];  // pool slots posted to the next recvmmsg, -1 if none
+static size_t rx_frame_size = RX_FRAME_LEN;
+static bool rx_gro = false;
+
+// batched ep6 transmission
+static struct mmsghdr tx_msgs[TX_BATCH_MAX];
+static struct iovec tx_iov[TX_BATCH_MAX];
+static bool tx_gso = false;
+
+// io_uring backend: multishot receive into a provided buffer ring, linked ep6 sends
+static hpsdr_uring_t rx_ring;
+static hpsdr_uring_t tx_ring;
+static bool rx_uring = false;
+static bool tx_uring = false;
+static unsigned uring_posted = 0;  // pool slots owned by the buffer ring
+static int uring_slot[URING_BUFS]; // which ones, -1: free entry
+static size_t uring_buf_len;
+static struct msghdr uring_msg;
+
+// event loop
+static int epoll_fd = -1;
+static int timer_fd = -1;
+static int ep6_fd = -1;   // single run mode: ep6 batch pacing
+static int dma_fd = -1;   // single run mode: dma feed pacing
+static int tcp_slot = -1; // pool slot collecting the current tcp packet
+static int tcp_fill = 0;  // bytes of it already received
+
+// pool exhausted: receive sources left the epoll set until the pool signals a free slot
+static bool udp_parked = false;
+static bool tcp_parked = false;
+static bool uring_parked = false;
+
+hpsdr_network_stats_t net_stats;
 
 uint8_t reply[11] = {
         0xef, //
@@ -78,14 +138,161 @@ uint8_t reply[11] = {
         1     //
         };
 
-uint8_t id[4] = {
-        0xef, //
-        0xfe, //
-        1,    //
-        6     //
-        };
+static int hpsdr_network_watch(int fd) {
+    struct epoll_event ev;
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = fd;
+    return epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+}
+
+// periodic timer, a zero period disarms it
+static void hpsdr_network_timer_arm(int fd, long period_ns) {
+    struct itimerspec its;
+
+    its.it_interval.tv_sec = period_ns / 1000000000L;
+    its.it_interval.tv_nsec = period_ns % 1000000000L;
+    its.it_value = its.it_interval;
+    timerfd_settime(fd, 0, &its, NULL);
+}
+
+// one shot at an absolute CLOCK_MONOTONIC time
+static void hpsdr_network_timer_at(int fd, uint64_t deadline_ns) {
+    struct itimerspec its = { 0 };
+
+    its.it_value.tv_sec = deadline_ns / 1000000000ULL;
+    its.it_value.tv_nsec = deadline_ns % 1000000000ULL;
+    timerfd_settime(fd, TFD_TIMER_ABSTIME, &its, NULL);
+}
+
+// a level-triggered fd that is not read stays ready: without a free slot it would spin the loop
+static void hpsdr_network_park(int fd, bool *parked) {
+    if (!hpsdr_pool_wait())
+        return;  // a slot came back meanwhile, the next wakeup takes it
+
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+    *parked = true;
+}
+
+static void hpsdr_network_tcp_close(void) {
+    if (sock_TCP_Client < 0)
+        return;
+
+    // closing drops the socket from the epoll set; listen again for the next client
+    close(sock_TCP_Client);
+    sock_TCP_Client = -1;
+    tcp_parked = false;
+    if (tcp_slot > -1) {
+        hpsdr_pool_put(tcp_slot);
+        tcp_slot = -1;
+    }
+    tcp_fill = 0;
+    hpsdr_network_watch(sock_TCP_Server);
+}
+
+static int hpsdr_network_uring_arm(void) {
+    struct io_uring_sqe *sqe;
+
+    if ((sqe = hpsdr_uring_get_sqe(&rx_ring)) == NULL)
+        return -1;
+
+#if HPSDR_HAVE_URING
+    sqe->opcode = IORING_OP_RECVMSG;
+    sqe->fd = sock_udp;
+    sqe->addr = (uint64_t) (uintptr_t) &uring_msg;
+    sqe->len = 1;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = URING_BGID;
+#endif
+
+    net_stats.rx_syscalls++;
+    return hpsdr_uring_submit(&rx_ring, 0) < 0 ? -1 : 0;
+}
+
+// keep the buffer ring full with free pool slots, the buffer id is the slot number
+static void hpsdr_network_uring_refill(void) {
+    int slot;
+
+    if (uring_posted == URING_BUFS)
+        return;
+
+    while (uring_posted < URING_BUFS && (slot = hpsdr_pool_get()) > -1) {
+        hpsdr_uring_pbuf_add(&rx_ring, hpsdr_pool_data(slot), uring_buf_len, slot);
+        for (int n = 0; n < URING_BUFS; n++) {
+            if (uring_slot[n] < 0) {
+                uring_slot[n] = slot;
+                break;
+            }
+        }
+        uring_posted++;
+    }
+    hpsdr_uring_pbuf_advance(&rx_ring);
+}
+
+// a completion handed the slot back from the buffer ring
+static void hpsdr_network_uring_taken(int slot) {
+    for (int n = 0; n < URING_BUFS; n++) {
+        if (uring_slot[n] == slot) {
+            uring_slot[n] = -1;
+            break;
+        }
+    }
+    uring_posted--;
+}
+
+// the buffer ring goes away: the slots still posted to it go back to the pool
+static void hpsdr_network_uring_release(void) {
+    for (int n = 0; n < URING_BUFS; n++) {
+        if (uring_slot[n] > -1)
+            hpsdr_pool_put(uring_slot[n]);
+        uring_slot[n] = -1;
+    }
+    uring_posted = 0;
+}
+
+static void hpsdr_network_uring_init(void) {
+    // each provided buffer receives: recvmsg header, source address, gro control, payload
+    memset(&uring_msg, 0, sizeof(uring_msg));
+    uring_msg.msg_namelen = sizeof(struct sockaddr_in);
+    uring_msg.msg_controllen = rx_gro ? CMSG_SPACE(sizeof(int)) : 0;
+#if HPSDR_HAVE_URING
+    uring_buf_len = sizeof(struct io_uring_recvmsg_out) + uring_msg.msg_namelen + uring_msg.msg_controllen + rx_frame_size;
+#endif
+
+    if (hpsdr_uring_init(&rx_ring, 4, 2 * URING_BUFS) < 0) {
+        hpsdr_dbg_printf(1, "io_uring not available (errno %d), using sockets\n", errno);
+        return;
+    }
+    if (hpsdr_uring_pbuf_init(&rx_ring, URING_BGID, URING_BUFS) < 0) {
+        hpsdr_dbg_printf(1, "io_uring buffer rings not supported by kernel, using sockets\n");
+        hpsdr_uring_deinit(&rx_ring);
+        return;
+    }
+    uring_posted = 0;
+    for (int n = 0; n < URING_BUFS; n++)
+        uring_slot[n] = -1;
+    hpsdr_network_uring_refill();
+
+    if (hpsdr_network_uring_arm() < 0) {
+        hpsdr_dbg_printf(1, "io_uring multishot receive failed, using sockets\n");
+        hpsdr_network_uring_release();
+        hpsdr_uring_deinit(&rx_ring);
+        return;
+    }
+    rx_uring = true;
+
+    if (hpsdr_uring_init(&tx_ring, TX_BATCH_MAX, 0) == 0)
+        tx_uring = true;
+
+    hpsdr_dbg_printf(1, "io_uring backend: rx %d x %d byte buffers, tx %s\n", URING_BUFS, (int) uring_buf_len, tx_uring ? "linked sends" : "sockets");
+}
 
 int hpsdr_network_init(void) {
+    int n, pool_min, pool_slots;
+    size_t slot_size;
+
     sock_TCP_Server = -1;
     sock_TCP_Client = -1;
 
@@ -97,9 +304,8 @@ int hpsdr_network_init(void) {
     setsockopt(sock_udp, SOL_SOCKET, SO_REUSEADDR, (void*) &yes, sizeof(yes));
     setsockopt(sock_udp, SOL_SOCKET, SO_REUSEPORT, (void*) &yes, sizeof(yes));
 
-    tv.tv_sec = 0;
-    tv.tv_usec = 1000;
-    setsockopt(sock_udp, SOL_SOCKET, SO_RCVTIMEO, (void*) &tv, sizeof(tv));
+    int flags = fcntl(sock_udp, F_GETFL, 0);
+    fcntl(sock_udp, F_SETFL, flags | O_NONBLOCK);
 
     memset(&addr_udp, 0, sizeof(addr_udp));
     addr_udp.sin_family = AF_INET;
@@ -111,6 +317,57 @@ int hpsdr_network_init(void) {
         return EXIT_FAILURE;
     }
 
+    // let the kernel coalesce bursts of equal sized datagrams (linux >= 5.0)
+    rx_gro = false;
+    if (config.global.rxgro) {
+        if (setsockopt(sock_udp, IPPROTO_UDP, UDP_GRO, (void*) &yes, sizeof(yes)) == 0) {
+            rx_gro = true;
+        } else {
+            hpsdr_dbg_printf(1, "UDP_GRO not supported by kernel, using plain batches\n");
+        }
+    }
+    rx_frame_size = rx_gro ? RX_GRO_LEN : RX_FRAME_LEN;
+
+    // every receive path lands in pool slots: one recvmmsg batch, the io_uring buffer ring and the tcp packet
+    // stay posted, the decode queue and the reorder window hold frames, the rest is headroom
+    pool_min = config.global.rxbatch + 1 + (config.global.netbackend == NET_IOURING ? URING_BUFS : 0);
+    if (config.pipeline.enabled)
+        pool_min += config.pipeline.queue;
+    pool_min += config.global.reorder;
+    pool_slots = config.global.pktpool;
+    if (pool_slots < 2 * pool_min) {
+        hpsdr_dbg_printf(1, "Packet pool: %d slots too few, using %d\n", pool_slots, 2 * pool_min);
+        pool_slots = 2 * pool_min;
+    }
+    slot_size = rx_frame_size;
+#if HPSDR_HAVE_URING
+    if (config.global.netbackend == NET_IOURING)
+        slot_size += sizeof(struct io_uring_recvmsg_out) + sizeof(struct sockaddr_in) + CMSG_SPACE(sizeof(int));
+#endif
+    if (hpsdr_pool_init(pool_slots, slot_size) < 0) {
+        hpsdr_dbg_printf(1, "ERROR: packet pool not allocated\n");
+        return EXIT_FAILURE;
+    }
+    for (n = 0; n < RX_BATCH_MAX; n++)
+        rx_slot[n] = -1;
+    hpsdr_dbg_printf(1, "UDP receive batch: %d frames, gro: %s\n", config.global.rxbatch, rx_gro ? "on" : "off");
+
+    // probe for udp segmentation offload (linux >= 4.18), the segment size itself goes with every send
+    tx_gso = false;
+    if (config.global.txgso) {
+        int gso_size;
+        socklen_t gso_len = sizeof(gso_size);
+        if (getsockopt(sock_udp, IPPROTO_UDP, UDP_SEGMENT, (void*) &gso_size, &gso_len) == 0) {
+            tx_gso = true;
+        } else {
+            hpsdr_dbg_printf(1, "UDP_SEGMENT not supported by kernel, using sendmmsg\n");
+        }
+    }
+    hpsdr_dbg_printf(1, "EP6 transmit batch: %d frames, gso: %s\n", config.global.txbatch, tx_gso ? "on" : "off");
+
+    if (config.global.netbackend == NET_IOURING)
+        hpsdr_network_uring_init();
+
     if ((sock_TCP_Server = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
         hpsdr_dbg_printf(1, "socket tcp");
         return EXIT_FAILURE;
@@ -125,9 +382,6 @@ int hpsdr_network_init(void) {
     int rcvbufsize = 65535;
     setsockopt(sock_TCP_Server, SOL_SOCKET, SO_SNDBUF, (const char*) &sndbufsize, sizeof(int));
     setsockopt(sock_TCP_Server, SOL_SOCKET, SO_RCVBUF, (const char*) &rcvbufsize, sizeof(int));
-    tv.tv_sec = 0;
-    tv.tv_usec = 1000;
-    setsockopt(sock_TCP_Server, SOL_SOCKET, SO_RCVTIMEO, (void*) &tv, sizeof(tv));
 
     if (bind(sock_TCP_Server, (struct sockaddr*) &addr_udp, sizeof(addr_udp)) < 0) {
         hpsdr_dbg_printf(1, "ERROR: bind tcp\n");
@@ -137,15 +391,73 @@ int hpsdr_network_init(void) {
     listen(sock_TCP_Server, 1024);
     hpsdr_dbg_printf(1, "Listening for TCP client connection request\n");
 
-    int flags = fcntl(sock_TCP_Server, F_GETFL, 0);
+    flags = fcntl(sock_TCP_Server, F_GETFL, 0);
     fcntl(sock_TCP_Server, F_SETFL, flags | O_NONBLOCK);
 
+    // everything the main loop waits for goes into one epoll set
+    if ((epoll_fd = epoll_create1(EPOLL_CLOEXEC)) < 0) {
+        hpsdr_dbg_printf(1, "ERROR: epoll_create1\n");
+        return EXIT_FAILURE;
+    }
+    if ((timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)) < 0) {
+        hpsdr_dbg_printf(1, "ERROR: timerfd_create\n");
+        return EXIT_FAILURE;
+    }
+    if (config.global.runmode == RUN_SINGLE) {
+        // ep6 frames and the dma feed run off the event loop instead of their own threads
+        ep6_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        dma_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        if (ep6_fd < 0 || dma_fd < 0 || hpsdr_network_watch(ep6_fd) < 0 || hpsdr_network_watch(dma_fd) < 0) {
+            hpsdr_dbg_printf(1, "ERROR: single run mode timers\n");
+            return EXIT_FAILURE;
+        }
+        hpsdr_dbg_printf(1, "Single run mode: ep6 and dma feed on the event loop\n");
+    }
+    if (config.global.statsinterval > 0) {
+        struct itimerspec its = {
+                .it_interval = { .tv_sec = config.global.statsinterval },
+                .it_value    = { .tv_sec = config.global.statsinterval }
+        };
+        timerfd_settime(timer_fd, 0, &its, NULL);
+    }
+
+    // the ring fd turns readable when receive completions are pending
+    if (hpsdr_network_watch(rx_uring ? rx_ring.fd : sock_udp) < 0 || hpsdr_network_watch(sock_TCP_Server) < 0 || hpsdr_network_watch(timer_fd) < 0
+            || hpsdr_network_watch(hpsdr_pool_event_fd()) < 0) {
+        hpsdr_dbg_printf(1, "ERROR: epoll_ctl\n");
+        return EXIT_FAILURE;
+    }
+
     return EXIT_SUCCESS;
 }
 
 void hpsdr_network_deinit(void) {
     close(sock_udp);
 
+    if (rx_uring || tx_uring) {
+        if (rx_uring)
+            hpsdr_network_uring_release();
+        hpsdr_uring_deinit(&rx_ring);
+        hpsdr_uring_deinit(&tx_ring);
+        rx_uring = tx_uring = false;
+    }
+
+    if (timer_fd > -1) {
+        close(timer_fd);
+        timer_fd = -1;
+    }
+
+    if (ep6_fd > -1) {
+        close(ep6_fd);
+        close(dma_fd);
+        ep6_fd = dma_fd = -1;
+    }
+
+    if (epoll_fd > -1) {
+        close(epoll_fd);
+        epoll_fd = -1;
+    }
+
     if (sock_TCP_Client > -1) {
         close(sock_TCP_Client);
     }
@@ -153,80 +465,55 @@ void hpsdr_network_deinit(void) {
     if (sock_TCP_Server > -1) {
         close(sock_TCP_Server);
     }
+
+    // the slots go away with the pool, whoever still held them
+    hpsdr_pool_deinit();
+    tcp_slot = -1;
+    udp_parked = tcp_parked = uring_parked = false;
 }
 
-int hpsdr_network_process(void) {
-    memcpy(buffer, id, 4);
+// both only post a request to the ep6 worker, in single run mode they also drive the timers
+static void hpsdr_network_ep6_stop(void) {
+    if (config.global.runmode == RUN_SINGLE && ep6_active()) {
+        hpsdr_network_timer_arm(ep6_fd, 0);
+        hpsdr_network_timer_arm(dma_fd, 0);
+    }
 
-    if (sock_TCP_Client > -1) {
-        // using recvmmsg with a time-out should be used for a byte-stream protocol like tcp
-        // (each "packet" in the datagram may be incomplete).
-        // this is especially true if the socket has a receive time-out, but this problem
-        // also occurs if the is no such receive time-out.
-        // therefore we read a complete packet here (1032 bytes).
-        // our tcp-extension to the hpsdr protocol ensures that only 1032-byte packets may arrive here.
-        bytes_read = 0;
-        bytes_left = 1032;
-        while (bytes_left > 0) {
-            size = recvfrom(sock_TCP_Client, buffer + bytes_read, (size_t) bytes_left, 0, NULL, 0);
-            if (size < 0 && errno == EAGAIN)
-                continue;
-            if (size < 0)
-                break;
-            bytes_read += size;
-            bytes_left -= size;
-        }
+    ep6_request_stop();
+}
 
-        bytes_read = size;
-        if (size >= 0) {
-            // 1032 bytes have successfully been read by tcp.
-            // let the downstream code know that there is a single packet, and its size
-            bytes_read = 1032;
+static void hpsdr_network_ep6_start(void) {
+    // a new session counts ep2 sequence numbers from zero again
+    hpsdr_pipeline_seq_reset();
+    ep6_request_start();
 
-            // in the case of a metis-discovery packet, change the size to 63
-            if (*code0 == 0x0002feef) {
-                bytes_read = 63;
-            }
+    if (config.global.runmode == RUN_SINGLE && ep6_active()) {
+        // the first batch goes out when the time for its samples has passed
+        ep6_build();
+        hpsdr_network_timer_at(ep6_fd, ep6_deadline());
+        hpsdr_network_timer_arm(dma_fd, iqsender_block_time());
+    }
+}
 
-            // in principle, we should check on (*code0 & 0x00ffffff) == 0x0004feef,
-            // then we cover all kinds of start and stop packets.
-            // in the case of a metis-stop packet, change the size to 64
-            if (*code0 == 0x0004feef) {
-                bytes_read = 64;
-            }
+// single run mode: send the batch that is due and build the next one
+static void hpsdr_network_ep6_tick(void) {
+    int sent = 0;
 
-            // in the case of a metis-start tcp packet, change the size to 64
-            // the special start code 0x11 has no function any longer, but we shall still support it.
-            if (*code0 == 0x1104feef || *code0 == 0x0104feef) {
-                bytes_read = 64;
-            }
-        }
-    } else {
-        lenaddr = sizeof(addr_from);
-        bytes_read = recvfrom(sock_udp, buffer, 1032, 0, (struct sockaddr*) &addr_from, &lenaddr);
-        if (bytes_read > 0) {
-            udp_retries = 0;
-        } else {
-            udp_retries++;
-        }
-    }
+    // a late loop sends what is due back to back, a few at a time so the other events get a turn
+    do {
+        ep6_late(hpsdr_pipeline_now());
+        ep6_send();
+        ep6_build();
+    } while (ep6_deadline() <= hpsdr_pipeline_now() && ++sent < CATCHUP_MAX);
 
-    if (bytes_read < 0 && errno != EAGAIN) {
-        hpsdr_dbg_printf(1, "recvfrom");
-        return EXIT_FAILURE;
-    }
+    hpsdr_network_timer_at(ep6_fd, ep6_deadline());
+}
 
-    // if nothing has arrived via udp for some time, try to open tcp connection.
-    // "for some time" means 10 subsequent un-successful udp rcvmmsg() calls
-    if (sock_TCP_Client < 0 && udp_retries > 10) {
-        if ((sock_TCP_Client = accept(sock_TCP_Server, NULL, NULL)) > -1) {
-            hpsdr_dbg_printf(1, "sock_TCP_Client: %d connected to sock_TCP_Server: %d\n", sock_TCP_Client, sock_TCP_Server);
-        }
-        // this avoids firing accept() too often if it constantly fails
-        udp_retries = 0;
-    }
-    if (bytes_read <= 0)
-        return EXIT_SUCCESS;
+// the packet stays valid for the duration of the call, keep a reference to hold on to it
+static int hpsdr_network_dispatch(const hpsdr_pkt_t *pkt) {
+    uint8_t *buffer = hpsdr_pkt_data(pkt);
+    int bytes_read = pkt->len;
+    uint8_t resp[60];  // replies are built here, never in the received slot
 
     memcpy(&code, buffer, 4);
 
@@ -242,21 +529,9 @@ int hpsdr_network_process(void) {
                 break;
             }
 
-            // sequence number check
-            seqnum = ((buffer[4] & 0xFF) << 24) + ((buffer[5] & 0xFF) << 16) + ((buffer[6] & 0xFF) << 8) + (buffer[7] & 0xFF);
-
-            if (seqnum != last_seqnum + 1) {
-                hpsdr_dbg_printf(1, "SEQ ERROR: last %ld, recvd %ld\n", (long) last_seqnum, (long) seqnum);
-            }
-
-            last_seqnum = seqnum;
-
-            ep2_handler(buffer + 11);
-            ep2_handler(buffer + 523);
-
-            if (active_thread) {
-                samples_rcv(buffer);
-            }
+            // hand the frame over to the decode stage without copying
+            hpsdr_pool_ref(pkt->slot);
+            hpsdr_pipeline_ep2(pkt);
             break;
 
             // respond to an incoming metis detection request
@@ -269,7 +544,7 @@ int hpsdr_network_process(void) {
                 break;
             }
             reply[2] = 2;
-            if (active_thread) {
+            if (ep6_active()) {
                 reply[2] = 3;
             }
             reply[9] = 31; // software version
@@ -279,23 +554,22 @@ int hpsdr_network_process(void) {
                 reply[9] = 41;
                 reply[10] = DEVICE_HERMES_LITE;
             }
-            memset(buffer, 0, 60);
-            memcpy(buffer, reply, 11);
+            memset(resp, 0, 60);
+            memcpy(resp, reply, 11);
 
             if (sock_TCP_Client > -1) {
                 // we will get into trouble if we respond via tcp while the radio is
                 // running with tcp.
                 // we simply suppress the response in this (very unlikely) case.
-                if (!active_thread) {
-                    if (send(sock_TCP_Client, buffer, 60, 0) < 0) {
+                if (!ep6_active()) {
+                    if (send(sock_TCP_Client, resp, 60, 0) < 0) {
                         hpsdr_dbg_printf(1, "TCP send error occurred when responding to an incoming Metis detection request!\n");
                     }
                     // close the tcp socket which was only used for the detection
-                    close(sock_TCP_Client);
-                    sock_TCP_Client = -1;
+                    hpsdr_network_tcp_close();
                 }
             } else {
-                sendto(sock_udp, buffer, 60, 0, (struct sockaddr*) &addr_from, sizeof(addr_from));
+                sendto(sock_udp, resp, 60, 0, (struct sockaddr*) &addr_from, sizeof(addr_from));
             }
 
             break;
@@ -310,14 +584,9 @@ int hpsdr_network_process(void) {
                 break;
             }
 
-            enable_thread = 0;
-            while (active_thread)
-                usleep(1000);
+            hpsdr_network_ep6_stop();
 
-            if (sock_TCP_Client > -1) {
-                close(sock_TCP_Client);
-                sock_TCP_Client = -1;
-            }
+            hpsdr_network_tcp_close();
             break;
 
             // start the pc-to-sdr handler thread
@@ -331,23 +600,13 @@ int hpsdr_network_process(void) {
             }
             hpsdr_dbg_printf(1, "START the PC-to-SDR handler thread / code: 0x%08x\n", code);
 
-            enable_thread = 0;
-            while (active_thread)
-                usleep(1000);
             memset(&addr, 0, sizeof(addr));
             addr.sin_family = AF_INET;
             addr.sin_addr.s_addr = addr_from.sin_addr.s_addr;
             addr.sin_port = addr_from.sin_port;
 
-            enable_thread = 1;
-            active_thread = 1;
-
-            if (pthread_create(&op_handler_ep6_id, NULL, ep6_handler, NULL) < 0) {
-                hpsdr_dbg_printf(1, "ERROR: create protocol thread");
-                return EXIT_FAILURE;
-            }
-            pthread_detach(op_handler_ep6_id);
-
+            // a running session is restarted by the worker
+            hpsdr_network_ep6_start();
             break;
 
             // non standard cases
@@ -358,9 +617,8 @@ int hpsdr_network_process(void) {
                 unsigned long blks = (buffer[4] << 24) + (buffer[5] << 16) + (buffer[6] << 8) + buffer[7];
                 hpsdr_dbg_printf(1, "Program blks=%lu count=%ld\r", blks, ++cnt);
 
-                hpsdr_program(buffer);
-
-                sendto(sock_udp, buffer, 60, 0, (struct sockaddr*) &addr_from, sizeof(addr_from));
+                // the control worker answers, receiving goes on meanwhile
+                hpsdr_control_post(CTL_PROGRAM, buffer, bytes_read, &addr_from);
                 if (blks == cnt)
                     hpsdr_dbg_printf(1, "\n\n Programming Done!\n");
                 break;
@@ -370,9 +628,7 @@ int hpsdr_network_process(void) {
             if (bytes_read == 64 && buffer[0] == 0xEF && buffer[1] == 0xFE && buffer[2] == 0x03 && buffer[3] == 0x02) {
                 hpsdr_dbg_printf(1, "Erase packet received:\n");
 
-                hpsdr_erase_packet(buffer);
-
-                sendto(sock_udp, buffer, 60, 0, (struct sockaddr*) &addr_from, sizeof(addr_from));
+                hpsdr_control_post(CTL_ERASE, buffer, bytes_read, &addr_from);
                 break;
 
             }
@@ -383,9 +639,7 @@ int hpsdr_network_process(void) {
                 hpsdr_dbg_printf(1, "MAC address is %02x:%02x:%02x:%02x:%02x:%02x\n", buffer[3], buffer[4], buffer[5], buffer[6], buffer[7], buffer[8]);
                 hpsdr_dbg_printf(1, "IP  address is %03d:%03d:%03d:%03d\n", buffer[9], buffer[10], buffer[11], buffer[12]);
 
-                hpsdr_set_ip(buffer);
-
-                sendto(sock_udp, buffer, 63, 0, (struct sockaddr*) &addr_from, sizeof(addr_from));
+                hpsdr_control_post(CTL_SETIP, buffer, bytes_read, &addr_from);
                 break;
             }
     }
@@ -393,14 +647,502 @@ int hpsdr_network_process(void) {
     return EXIT_SUCCESS;
 }
 
+// a gro datagram is a train of equal sized segments (the last may be shorter)
+static int hpsdr_network_gro_segment(struct msghdr *msg, int len) {
+    struct cmsghdr *cmsg;
+    int seg = len;
+
+    if (!rx_gro)
+        return len;
+
+    for (cmsg = CMSG_FIRSTHDR(msg); cmsg != NULL; cmsg = CMSG_NXTHDR(msg, cmsg)) {
+        if (cmsg->cmsg_level == IPPROTO_UDP && cmsg->cmsg_type == UDP_GRO) {
+            memcpy(&seg, CMSG_DATA(cmsg), sizeof(int));
+            break;
+        }
+    }
+
+    return seg > 0 ? seg : len;
+}
+
+// every segment of the datagram at off in the slot becomes its own packet
+static int hpsdr_network_deliver(int slot, uint32_t off, int len, int seg) {
+    hpsdr_pkt_t pkt;
+    int n;
+
+    pkt.slot = slot;
+    for (n = 0; n < len; n += seg) {
+        pkt.off = off + n;
+        pkt.len = (len - n) < seg ? (len - n) : seg;
+        net_stats.rx_frames++;
+        if (hpsdr_network_dispatch(&pkt) != EXIT_SUCCESS)
+            return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+static int hpsdr_network_uring_receive(void) {
+#if HPSDR_HAVE_URING
+    struct io_uring_cqe *cqe;
+    struct io_uring_recvmsg_out *out;
+    struct msghdr msg;
+    uint8_t *buf;
+    uint32_t payload;
+    unsigned flags;
+    int res, bid, ret = EXIT_SUCCESS;
+
+    while (ret == EXIT_SUCCESS && (cqe = hpsdr_uring_peek_cqe(&rx_ring)) != NULL) {
+        res = cqe->res;
+        flags = cqe->flags;
+        hpsdr_uring_cqe_seen(&rx_ring);
+
+        if (res < 0) {
+            if (res == -EINVAL || res == -EOPNOTSUPP) {
+                // kernel without multishot recvmsg: go back to the socket for good
+                hpsdr_dbg_printf(1, "io_uring multishot recvmsg not supported by kernel, using sockets\n");
+                epoll_ctl(epoll_fd, EPOLL_CTL_DEL, rx_ring.fd, NULL);
+                hpsdr_network_uring_release();
+                hpsdr_uring_deinit(&rx_ring);
+                rx_uring = false;
+                hpsdr_network_watch(sock_udp);
+                return EXIT_SUCCESS;
+            }
+            if (res != -ENOBUFS)
+                hpsdr_dbg_printf(1, "io_uring recvmsg error %d\n", res);
+        } else if (flags & IORING_CQE_F_BUFFER) {
+            // the buffer id is the pool slot, the ring no longer owns it
+            bid = flags >> IORING_CQE_BUFFER_SHIFT;
+            hpsdr_network_uring_taken(bid);
+            buf = hpsdr_pool_data(bid);
+            out = (struct io_uring_recvmsg_out*) buf;
+            payload = sizeof(*out) + uring_msg.msg_namelen + uring_msg.msg_controllen;
+
+            if (out->flags & MSG_TRUNC) {
+                hpsdr_dbg_printf(1, "InvalidLength: truncated datagram Len=%d\n", (int) out->payloadlen);
+            } else {
+                memcpy(&addr_from, buf + sizeof(*out), sizeof(addr_from));
+                memset(&msg, 0, sizeof(msg));
+                msg.msg_control = buf + sizeof(*out) + uring_msg.msg_namelen;
+                msg.msg_controllen = out->controllen;
+                ret = hpsdr_network_deliver(bid, payload, out->payloadlen, hpsdr_network_gro_segment(&msg, out->payloadlen));
+            }
+
+            // drop the receive reference, the kernel gets the next free slot
+            hpsdr_pool_put(bid);
+            hpsdr_network_uring_refill();
+        }
+
+        // the multishot request ends on errors or when buffers run out: re-arm it,
+        // with whatever slots later stages have given back meanwhile
+        if (!(flags & IORING_CQE_F_MORE)) {
+            hpsdr_network_uring_refill();
+            if (uring_posted == 0 && hpsdr_pool_wait()) {
+                // nothing to receive into, a request now would end in -ENOBUFS straight away
+                uring_parked = true;
+                continue;
+            }
+            hpsdr_network_uring_refill();
+            if (hpsdr_network_uring_arm() < 0) {
+                hpsdr_dbg_printf(1, "ERROR: io_uring re-arm\n");
+                return EXIT_FAILURE;
+            }
+        }
+    }
+
+    return ret;
+#else
+    return EXIT_SUCCESS;
+#endif
+}
+
+static int hpsdr_network_receive_batch(void) {
+    int n, m, ret;
+    int len;
+
+    // post a free slot for each frame of the batch; slots not filled last time are still there
+    for (n = 0; n < config.global.rxbatch; n++) {
+        if (rx_slot[n] < 0 && (rx_slot[n] = hpsdr_pool_get()) < 0)
+            break;
+        rx_iov[n].iov_base = hpsdr_pool_data(rx_slot[n]);
+        rx_iov[n].iov_len = rx_frame_size;
+        memset(&rx_msgs[n].msg_hdr, 0, sizeof(struct msghdr));
+        rx_msgs[n].msg_hdr.msg_name = &rx_from[n];
+        rx_msgs[n].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+        rx_msgs[n].msg_hdr.msg_iov = &rx_iov[n];
+        rx_msgs[n].msg_hdr.msg_iovlen = 1;
+        if (rx_gro) {
+            rx_msgs[n].msg_hdr.msg_control = rx_cmsg[n];
+            rx_msgs[n].msg_hdr.msg_controllen = sizeof(rx_cmsg[n]);
+        }
+    }
+
+    // pool exhausted: leave the datagrams queued in the kernel until slots come back
+    if (n == 0) {
+        hpsdr_network_park(sock_udp, &udp_parked);
+        return EXIT_SUCCESS;
+    }
+
+    // the socket is readable: take whatever is queued, up to one batch
+    m = recvmmsg(sock_udp, rx_msgs, n, MSG_DONTWAIT, NULL);
+    if (m <= 0) {
+        if (m < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+            hpsdr_dbg_printf(1, "recvmmsg");
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
+    net_stats.rx_syscalls++;
+
+    for (n = 0, ret = EXIT_SUCCESS; n < m; n++) {
+        len = rx_msgs[n].msg_len;
+        if (rx_msgs[n].msg_hdr.msg_flags & MSG_TRUNC) {
+            hpsdr_dbg_printf(1, "InvalidLength: truncated datagram Len=%d\n", len);
+        } else if (ret == EXIT_SUCCESS) {
+            addr_from = rx_from[n];
+            ret = hpsdr_network_deliver(rx_slot[n], 0, len, hpsdr_network_gro_segment(&rx_msgs[n].msg_hdr, len));
+        }
+
+        // drop the receive reference, whoever kept the frame still holds its own
+        hpsdr_pool_put(rx_slot[n]);
+        rx_slot[n] = -1;
+    }
+
+    return ret;
+}
+
+static int hpsdr_network_tcp_accept(void) {
+    int fd;
+
+    // the client stays blocking for the ep6 sends, receives use MSG_DONTWAIT
+    if ((fd = accept(sock_TCP_Server, NULL, NULL)) < 0)
+        return EXIT_SUCCESS;
+
+    sock_TCP_Client = fd;
+    tcp_fill = 0;
+    hpsdr_dbg_printf(1, "sock_TCP_Client: %d connected to sock_TCP_Server: %d\n", sock_TCP_Client, sock_TCP_Server);
+
+    // serve one client at a time: further ones wait in the backlog until this one is gone
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, sock_TCP_Server, NULL);
+    if (hpsdr_network_watch(sock_TCP_Client) < 0) {
+        hpsdr_dbg_printf(1, "ERROR: epoll_ctl tcp client\n");
+        hpsdr_network_tcp_close();
+    }
+
+    return EXIT_SUCCESS;
+}
+
+static int hpsdr_network_tcp_receive(void) {
+    hpsdr_pkt_t pkt;
+    uint32_t code0;
+    int ret;
+
+    if (tcp_slot < 0 && (tcp_slot = hpsdr_pool_get()) < 0) {
+        hpsdr_network_park(sock_TCP_Client, &tcp_parked);
+        return EXIT_SUCCESS;
+    }
+
+    // tcp is a byte stream: collect the bytes of a packet until it is complete.
+    // our tcp-extension to the hpsdr protocol ensures that only 1032-byte packets may arrive here.
+    size = recv(sock_TCP_Client, hpsdr_pool_data(tcp_slot) + tcp_fill, (size_t) (1032 - tcp_fill), MSG_DONTWAIT);
+    if (size < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+        return EXIT_SUCCESS;
+    if (size <= 0) {
+        hpsdr_dbg_printf(1, "sock_TCP_Client: %d disconnected\n", sock_TCP_Client);
+        hpsdr_network_tcp_close();
+        return EXIT_SUCCESS;
+    }
+
+    net_stats.rx_syscalls++;
+    tcp_fill += size;
+    if (tcp_fill < 1032)
+        return EXIT_SUCCESS;
+    tcp_fill = 0;
+
+    // 1032 bytes have successfully been read by tcp.
+    // let the downstream code know that there is a single packet, and its size
+    bytes_read = 1032;
+    memcpy(&code0, hpsdr_pool_data(tcp_slot), 4);
+
+    // in the case of a metis-discovery packet, change the size to 63
+    if (code0 == 0x0002feef) {
+        bytes_read = 63;
+    }
+
+    // in principle, we should check on (code0 & 0x00ffffff) == 0x0004feef,
+    // then we cover all kinds of start and stop packets.
+    // in the case of a metis-stop packet, change the size to 64
+    if (code0 == 0x0004feef) {
+        bytes_read = 64;
+    }
+
+    // in the case of a metis-start tcp packet, change the size to 64
+    // the special start code 0x11 has no function any longer, but we shall still support it.
+    if (code0 == 0x1104feef || code0 == 0x0104feef) {
+        bytes_read = 64;
+    }
+
+    // the slot leaves tcp_slot first: dispatch may close the connection
+    pkt.slot = tcp_slot;
+    pkt.off = 0;
+    pkt.len = bytes_read;
+    tcp_slot = -1;
+
+    net_stats.rx_frames++;
+    ret = hpsdr_network_dispatch(&pkt);
+    hpsdr_pool_put(pkt.slot);
+
+    return ret;
+}
+
+// slots are back: receive sources parked on an empty pool go back to work
+static int hpsdr_network_unpark(void) {
+    if (udp_parked) {
+        udp_parked = false;
+        hpsdr_network_watch(sock_udp);
+    }
+    if (tcp_parked) {
+        tcp_parked = false;
+        hpsdr_network_watch(sock_TCP_Client);
+    }
+    if (uring_parked) {
+        uring_parked = false;
+        hpsdr_network_uring_refill();
+        if (hpsdr_network_uring_arm() < 0) {
+            hpsdr_dbg_printf(1, "ERROR: io_uring re-arm\n");
+            return EXIT_FAILURE;
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
+
+int hpsdr_network_process(void) {
+    struct epoll_event events[EV_MAX];
+    uint64_t expirations, start, frames;
+    int n, nev, fd;
+
+    // sleep until there is something to do
+    nev = epoll_wait(epoll_fd, events, EV_MAX, -1);
+    if (nev < 0) {
+        if (errno == EINTR)
+            return EXIT_SUCCESS;
+        hpsdr_dbg_printf(1, "epoll_wait");
+        return EXIT_FAILURE;
+    }
+    net_stats.wakeups++;
+    start = hpsdr_pipeline_now();
+    frames = net_stats.rx_frames;
+
+    for (n = 0; n < nev; n++) {
+        fd = events[n].data.fd;
+
+        if (fd == sock_udp) {
+            if (hpsdr_network_receive_batch() != EXIT_SUCCESS)
+                return EXIT_FAILURE;
+        } else if (rx_uring && fd == rx_ring.fd) {
+            if (hpsdr_network_uring_receive() != EXIT_SUCCESS)
+                return EXIT_FAILURE;
+        } else if (fd == sock_TCP_Server) {
+            if (sock_TCP_Client < 0)
+                hpsdr_network_tcp_accept();
+        } else if (fd == hpsdr_pool_event_fd()) {
+            if (read(fd, &expirations, sizeof(expirations)) > 0 && hpsdr_network_unpark() != EXIT_SUCCESS)
+                return EXIT_FAILURE;
+        } else if (fd == timer_fd) {
+            if (read(timer_fd, &expirations, sizeof(expirations)) > 0)
+                stats_request = 1;
+        } else if (fd == ep6_fd) {
+            if (read(ep6_fd, &expirations, sizeof(expirations)) > 0 && ep6_active())
+                hpsdr_network_ep6_tick();
+        } else if (fd == dma_fd) {
+            if (read(dma_fd, &expirations, sizeof(expirations)) > 0) {
+                if (expirations > TXLEN)
+                    expirations = TXLEN;
+                while (expirations-- && iqsender_tx_block())
+                    ;
+            }
+        } else if (fd == sock_TCP_Client) {
+            if (hpsdr_network_tcp_receive() != EXIT_SUCCESS)
+                return EXIT_FAILURE;
+        }
+    }
+    hpsdr_pipeline_account(STAGE_NET, start, net_stats.rx_frames - frames);
+
+    return EXIT_SUCCESS;
+}
+
+// a udp reply from any thread
+void hpsdr_network_reply(const uint8_t *buffer, size_t len, const struct sockaddr_in *to) {
+    if (sendto(sock_udp, buffer, len, 0, (const struct sockaddr*) to, sizeof(*to)) < 0)
+        hpsdr_dbg_printf(1, "reply send error (errno %d)\n", errno);
+}
+
+// a byte stream: every frame goes out whole or the host loses track of the frame boundaries
+static int hpsdr_network_tcp_write(const uint8_t *buffer, size_t len) {
+    struct pollfd pfd;
+    ssize_t sent;
+
+    while (len > 0) {
+        sent = send(sock_TCP_Client, buffer, len, MSG_NOSIGNAL);
+        net_stats.tx_syscalls++;
+        if (sent < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                pfd.fd = sock_TCP_Client;
+                pfd.events = POLLOUT;
+                if (poll(&pfd, 1, -1) < 0 && errno != EINTR)
+                    return -1;
+                continue;
+            }
+            return -1;
+        }
+        buffer += sent;
+        len -= sent;
+    }
+
+    return 0;
+}
+
 void hpsdr_network_send(uint8_t *buffer, size_t len) {
-    int counter;
     if (sock_TCP_Client > -1) {
-        counter = sendto(sock_TCP_Client, buffer, 1032, 0, (struct sockaddr*) &addr, sizeof(addr));
-        if (counter < 0) {
-            hpsdr_dbg_printf(1, "TCP sendmsg error occurred at sequence number: %u !\n", counter);
+        if (hpsdr_network_tcp_write(buffer, 1032) < 0) {
+            hpsdr_dbg_printf(1, "TCP send error occurred in ep6 frame (errno %d)\n", errno);
+            net_stats.tx_errors++;
         }
     } else {
-        sendto(sock_udp, buffer, 1032, 0, (struct sockaddr*) &addr, sizeof(addr));
+        if (sendto(sock_udp, buffer, 1032, 0, (struct sockaddr*) &addr, sizeof(addr)) < 0)
+            net_stats.tx_errors++;
+        net_stats.tx_syscalls++;
+    }
+    net_stats.tx_frames++;
+}
+
+// queue the prepared tx_msgs as linked chains, so they leave in order, and reap each chain in one syscall;
+// returns how many frames went out through the ring, the caller sends the rest
+static int hpsdr_network_uring_send(int count) {
+#if HPSDR_HAVE_URING
+    struct io_uring_sqe *sqe, *last;
+    struct io_uring_cqe *cqe;
+    int done = 0, n, ret;
+
+    while (done < count) {
+        // a full submission queue ends the chain early, the rest follows once it completed
+        last = NULL;
+        for (n = done; n < count; n++) {
+            if ((sqe = hpsdr_uring_get_sqe(&tx_ring)) == NULL)
+                break;
+            sqe->opcode = IORING_OP_SENDMSG;
+            sqe->fd = sock_udp;
+            sqe->addr = (uint64_t) (uintptr_t) &tx_msgs[n].msg_hdr;
+            sqe->len = 1;
+            sqe->flags = IOSQE_IO_LINK;
+            sqe->user_data = n;
+            last = sqe;
+        }
+        if (last == NULL)
+            break;
+        last->flags = 0;
+
+        ret = hpsdr_uring_submit(&tx_ring, n - done);
+        net_stats.tx_syscalls++;
+        if (ret < 0) {
+            hpsdr_dbg_printf(1, "io_uring send failed (%d), using sendmmsg\n", ret);
+            tx_uring = false;
+            break;
+        }
+
+        while ((cqe = hpsdr_uring_peek_cqe(&tx_ring)) != NULL) {
+            if (cqe->res < 0)
+                net_stats.tx_errors++;
+            else
+                net_stats.tx_frames++;
+            hpsdr_uring_cqe_seen(&tx_ring);
+        }
+        done = n;
+    }
+
+    return done;
+#else
+    return 0;
+#endif
+}
+
+// send count consecutive 1032-byte frames with a single syscall if possible
+void hpsdr_network_send_batch(uint8_t *frames, int count) {
+    int n, first, sent;
+    struct msghdr msg;
+    struct cmsghdr *cmsg;
+    uint8_t control[CMSG_SPACE(sizeof(uint16_t))];
+
+    if (count == 1) {
+        hpsdr_network_send(frames, TX_FRAME_LEN);
+        return;
+    }
+
+    if (sock_TCP_Client > -1) {
+        // a byte stream: the frames are already contiguous
+        if (hpsdr_network_tcp_write(frames, count * TX_FRAME_LEN) < 0) {
+            hpsdr_dbg_printf(1, "TCP send error occurred in ep6 batch (errno %d)\n", errno);
+            net_stats.tx_errors++;
+            return;
+        }
+        net_stats.tx_frames += count;
+        return;
+    }
+
+    if (tx_gso && !tx_uring) {
+        // one super-datagram, cut into 1032-byte frames by the kernel
+        tx_iov[0].iov_base = frames;
+        tx_iov[0].iov_len = count * TX_FRAME_LEN;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_name = &addr;
+        msg.msg_namelen = sizeof(addr);
+        msg.msg_iov = tx_iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = IPPROTO_UDP;
+        cmsg->cmsg_type = UDP_SEGMENT;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+        *(uint16_t*) CMSG_DATA(cmsg) = TX_FRAME_LEN;
+
+        net_stats.tx_syscalls++;
+        if (sendmsg(sock_udp, &msg, 0) >= 0) {
+            net_stats.tx_frames += count;
+            return;
+        }
+        // some drivers refuse segmentation at runtime: fall back for good
+        hpsdr_dbg_printf(1, "UDP_SEGMENT send failed (errno %d), using sendmmsg\n", errno);
+        net_stats.tx_errors++;
+        tx_gso = false;
+    }
+
+    for (n = 0; n < count; n++) {
+        tx_iov[n].iov_base = frames + n * TX_FRAME_LEN;
+        tx_iov[n].iov_len = TX_FRAME_LEN;
+        memset(&tx_msgs[n].msg_hdr, 0, sizeof(struct msghdr));
+        tx_msgs[n].msg_hdr.msg_name = &addr;
+        tx_msgs[n].msg_hdr.msg_namelen = sizeof(addr);
+        tx_msgs[n].msg_hdr.msg_iov = &tx_iov[n];
+        tx_msgs[n].msg_hdr.msg_iovlen = 1;
+    }
+
+    n = tx_uring ? hpsdr_network_uring_send(count) : 0;
+    if (n == count)
+        return;
+
+    first = n;
+    while (n < count) {
+        sent = sendmmsg(sock_udp, tx_msgs + n, count - n, 0);
+        net_stats.tx_syscalls++;
+        if (sent <= 0) {
+            net_stats.tx_errors++;
+            break;
+        }
+        n += sent;
     }
+    net_stats.tx_frames += n - first;
 }
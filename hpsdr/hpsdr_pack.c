@@ -0,0 +1,541 @@
+/*
+ * Copyright 2021 Emiliano Gonzalez LU3VEA (lu3vea @ gmail . com))
+ * * Project Site: https://github.com/hiperiondev/hpsdr-p1-rpitx *
+ *
+ * This is based on other projects:
+ *    librpitx (https://github.com/F5OEO/librpitx)
+ *    HPSDR simulator (https://github.com/g0orx/pihpsdr)
+ *    small-memory XML config database library (https://github.com/dleonard0/mxml)
+ *
+ *    please contact their authors for more information.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ *
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "hpsdr_debug.h"
+#include "hpsdr_pack.h"
+
+// cleared by hpsdr_pack_init if the vector kernel does not match the scalar one
+static bool use_simd = true;
+
+static uint64_t pack_now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static inline void pack_sample(uint8_t *p, int32_t v) {
+    p[0] = (v >> 16) & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+    p[2] = v & 0xFF;
+}
+
+// one 32-bit word of a byte recording, any alignment (the kernels assume a little endian host)
+static inline uint32_t pack_load32(const uint8_t *p) {
+    uint32_t v;
+
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline int32_t pack_float(const float *src) {
+    float f;
+
+    memcpy(&f, src, sizeof(f));
+    f = f > 1.0f ? 1.0f : (f < -1.0f ? -1.0f : f);
+    return lrintf(f * PACK_SCALE);
+}
+
+// n samples: I2 I1 I0 Q2 Q1 Q0 for every receiver, then two bytes of (silent) microphone
+void hpsdr_pack_s32_scalar(uint8_t *dst, const int32_t *const *src, unsigned stride, int receivers, int n) {
+    for (int j = 0; j < n; j++) {
+        for (int k = 0; k < receivers; k++, dst += 6) {
+            pack_sample(dst, src[k][j * stride]);
+            pack_sample(dst + 3, src[k][j * stride + 1]);
+        }
+        *dst++ = 0;
+        *dst++ = 0;
+    }
+}
+
+void hpsdr_pack_f32_scalar(uint8_t *dst, const float *const *src, unsigned stride, int receivers, int n) {
+    for (int j = 0; j < n; j++) {
+        for (int k = 0; k < receivers; k++, dst += 6) {
+            pack_sample(dst, pack_float(src[k] + j * stride));
+            pack_sample(dst + 3, pack_float(src[k] + j * stride + 1));
+        }
+        *dst++ = 0;
+        *dst++ = 0;
+    }
+}
+
+// byte sources: Q follows I directly, the next sample is stride bytes on
+void hpsdr_pack_s16_scalar(uint8_t *dst, const uint8_t *const *src, unsigned stride, int receivers, int n) {
+    for (int j = 0; j < n; j++) {
+        for (int k = 0; k < receivers; k++, dst += 6) {
+            const uint8_t *s = src[k] + (size_t) j * stride;
+
+            dst[0] = s[1];
+            dst[1] = s[0];
+            dst[2] = 0;
+            dst[3] = s[3];
+            dst[4] = s[2];
+            dst[5] = 0;
+        }
+        *dst++ = 0;
+        *dst++ = 0;
+    }
+}
+
+void hpsdr_pack_s24_scalar(uint8_t *dst, const uint8_t *const *src, unsigned stride, int receivers, int n) {
+    for (int j = 0; j < n; j++) {
+        for (int k = 0; k < receivers; k++, dst += 6) {
+            const uint8_t *s = src[k] + (size_t) j * stride;
+
+            dst[0] = s[2];
+            dst[1] = s[1];
+            dst[2] = s[0];
+            dst[3] = s[5];
+            dst[4] = s[4];
+            dst[5] = s[3];
+        }
+        *dst++ = 0;
+        *dst++ = 0;
+    }
+}
+
+// The vector kernels turn each I/Q pair into one 64-bit word I2 I1 I0 Q2 Q1 Q0 0 0 and store
+// it whole. Receivers go in order, so the two zero bytes are overwritten by the next receiver
+// or land on the microphone slot. Two samples per round.
+#if defined(__ARM_NEON)
+static inline void pack_store(uint8_t *p0, uint8_t *p1, uint32x4_t v) {
+    uint64x2_t x = vreinterpretq_u64_u32(vshrq_n_u32(vreinterpretq_u32_u8(vrev32q_u8(vreinterpretq_u8_u32(v))), 8));
+
+    x = vorrq_u64(vandq_u64(x, vdupq_n_u64(0xffffffULL)), vandq_u64(vshrq_n_u64(x, 8), vdupq_n_u64(0xffffff000000ULL)));
+    vst1_u8(p0, vreinterpret_u8_u64(vget_low_u64(x)));
+    vst1_u8(p1, vreinterpret_u8_u64(vget_high_u64(x)));
+}
+
+static int pack_s32_simd(uint8_t *dst, const int32_t *const *src, unsigned stride, int receivers, int n) {
+    int size = receivers * 6 + 2;
+
+    n &= ~1;
+    for (int k = 0; k < receivers; k++) {
+        const int32_t *s = src[k];
+        uint8_t *out = dst + 6 * k;
+
+        for (int j = 0; j < n; j += 2) {
+            int32x4_t v = vcombine_s32(vld1_s32(s + j * stride), vld1_s32(s + (j + 1) * stride));
+
+            pack_store(out + j * size, out + (j + 1) * size, vreinterpretq_u32_s32(v));
+        }
+    }
+
+    return n;
+}
+
+#if defined(__aarch64__)
+static int pack_f32_simd(uint8_t *dst, const float *const *src, unsigned stride, int receivers, int n) {
+    int size = receivers * 6 + 2;
+
+    n &= ~1;
+    for (int k = 0; k < receivers; k++) {
+        const float *s = src[k];
+        uint8_t *out = dst + 6 * k;
+
+        for (int j = 0; j < n; j += 2) {
+            float32x4_t f = vcombine_f32(vld1_f32(s + j * stride), vld1_f32(s + (j + 1) * stride));
+
+            f = vminq_f32(vmaxq_f32(f, vdupq_n_f32(-1.0f)), vdupq_n_f32(1.0f));
+            pack_store(out + j * size, out + (j + 1) * size, vreinterpretq_u32_s32(vcvtnq_s32_f32(vmulq_n_f32(f, PACK_SCALE))));
+        }
+    }
+
+    return n;
+}
+#else
+// armv7 has no round-to-nearest conversion, stay with lrintf
+static int pack_f32_simd(uint8_t *dst, const float *const *src, unsigned stride, int receivers, int n) {
+    return 0;
+}
+#endif
+
+// I and Q of a 16 bit pair share one word: widen them to the 24 bit range
+static int pack_s16_simd(uint8_t *dst, const uint8_t *const *src, unsigned stride, int receivers, int n) {
+    int size = receivers * 6 + 2;
+
+    n &= ~1;
+    for (int k = 0; k < receivers; k++) {
+        const uint8_t *s = src[k];
+        uint8_t *out = dst + 6 * k;
+
+        for (int j = 0; j < n; j += 2, s += 2 * stride) {
+            uint32_t w[2] = { pack_load32(s), pack_load32(s + stride) };
+
+            pack_store(out + j * size, out + (j + 1) * size, vreinterpretq_u32_s32(vshll_n_s16(vreinterpret_s16_u32(vld1_u32(w)), 8)));
+        }
+    }
+
+    return n;
+}
+
+// a 24 bit pair is six bytes: load I at 0 and Q at 2, then drop the byte below Q
+static int pack_s24_simd(uint8_t *dst, const uint8_t *const *src, unsigned stride, int receivers, int n) {
+    const int32_t shift[4] = { 0, -8, 0, -8 };
+    const int32x4_t q = vld1q_s32(shift);
+    int size = receivers * 6 + 2;
+
+    n &= ~1;
+    for (int k = 0; k < receivers; k++) {
+        const uint8_t *s = src[k];
+        uint8_t *out = dst + 6 * k;
+
+        for (int j = 0; j < n; j += 2, s += 2 * stride) {
+            uint32_t w[4] = { pack_load32(s), pack_load32(s + 2), pack_load32(s + stride), pack_load32(s + stride + 2) };
+
+            pack_store(out + j * size, out + (j + 1) * size, vshlq_u32(vld1q_u32(w), q));
+        }
+    }
+
+    return n;
+}
+#elif defined(__SSE2__)
+static inline void pack_store(uint8_t *p0, uint8_t *p1, __m128i v) {
+    const __m128i byte = _mm_set1_epi32(0xff);
+    const __m128i lo = _mm_set_epi32(0, 0xffffff, 0, 0xffffff);
+    const __m128i hi = _mm_set_epi32(0xffff, 0xff000000, 0xffff, 0xff000000);
+    __m128i x;
+
+    // 24 bit byte swap in each lane, then I and Q side by side in each 64-bit half
+    x = _mm_or_si128(_mm_slli_epi32(_mm_and_si128(v, byte), 16), _mm_and_si128(v, _mm_slli_epi32(byte, 8)));
+    x = _mm_or_si128(x, _mm_and_si128(_mm_srli_epi32(v, 16), byte));
+    x = _mm_or_si128(_mm_and_si128(x, lo), _mm_and_si128(_mm_srli_epi64(x, 8), hi));
+    _mm_storel_epi64((__m128i*) p0, x);
+    _mm_storel_epi64((__m128i*) p1, _mm_unpackhi_epi64(x, x));
+}
+
+static inline __m128i pack_load(const void *p0, const void *p1) {
+    return _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i*) p0), _mm_loadl_epi64((const __m128i*) p1));
+}
+
+static int pack_s32_simd(uint8_t *dst, const int32_t *const *src, unsigned stride, int receivers, int n) {
+    int size = receivers * 6 + 2;
+
+    n &= ~1;
+    for (int k = 0; k < receivers; k++) {
+        const int32_t *s = src[k];
+        uint8_t *out = dst + 6 * k;
+
+        for (int j = 0; j < n; j += 2)
+            pack_store(out + j * size, out + (j + 1) * size, pack_load(s + j * stride, s + (j + 1) * stride));
+    }
+
+    return n;
+}
+
+static int pack_f32_simd(uint8_t *dst, const float *const *src, unsigned stride, int receivers, int n) {
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 scale = _mm_set1_ps(PACK_SCALE);
+    int size = receivers * 6 + 2;
+
+    n &= ~1;
+    for (int k = 0; k < receivers; k++) {
+        const float *s = src[k];
+        uint8_t *out = dst + 6 * k;
+
+        for (int j = 0; j < n; j += 2) {
+            __m128 f = _mm_castsi128_ps(pack_load(s + j * stride, s + (j + 1) * stride));
+
+            f = _mm_min_ps(_mm_max_ps(f, _mm_sub_ps(_mm_setzero_ps(), one)), one);
+            pack_store(out + j * size, out + (j + 1) * size, _mm_cvtps_epi32(_mm_mul_ps(f, scale)));
+        }
+    }
+
+    return n;
+}
+
+// I and Q of a 16 bit pair share one word: each sample to the top of its lane, then down to 24 bits
+static int pack_s16_simd(uint8_t *dst, const uint8_t *const *src, unsigned stride, int receivers, int n) {
+    int size = receivers * 6 + 2;
+
+    n &= ~1;
+    for (int k = 0; k < receivers; k++) {
+        const uint8_t *s = src[k];
+        uint8_t *out = dst + 6 * k;
+
+        for (int j = 0; j < n; j += 2, s += 2 * stride) {
+            __m128i v = _mm_unpacklo_epi32(_mm_cvtsi32_si128(pack_load32(s)), _mm_cvtsi32_si128(pack_load32(s + stride)));
+
+            pack_store(out + j * size, out + (j + 1) * size, _mm_srli_epi32(_mm_unpacklo_epi16(_mm_setzero_si128(), v), 8));
+        }
+    }
+
+    return n;
+}
+
+// a 24 bit pair is six bytes: load I at 0 and Q at 2, then drop the byte below Q
+static int pack_s24_simd(uint8_t *dst, const uint8_t *const *src, unsigned stride, int receivers, int n) {
+    const __m128i i = _mm_set_epi32(0, -1, 0, -1);
+    int size = receivers * 6 + 2;
+
+    n &= ~1;
+    for (int k = 0; k < receivers; k++) {
+        const uint8_t *s = src[k];
+        uint8_t *out = dst + 6 * k;
+
+        for (int j = 0; j < n; j += 2, s += 2 * stride) {
+            __m128i v = _mm_set_epi32(pack_load32(s + stride + 2), pack_load32(s + stride), pack_load32(s + 2), pack_load32(s));
+
+            v = _mm_or_si128(_mm_and_si128(v, i), _mm_andnot_si128(i, _mm_srli_epi32(v, 8)));
+            pack_store(out + j * size, out + (j + 1) * size, v);
+        }
+    }
+
+    return n;
+}
+#else
+static int pack_s32_simd(uint8_t *dst, const int32_t *const *src, unsigned stride, int receivers, int n) {
+    return 0;
+}
+
+static int pack_f32_simd(uint8_t *dst, const float *const *src, unsigned stride, int receivers, int n) {
+    return 0;
+}
+
+static int pack_s16_simd(uint8_t *dst, const uint8_t *const *src, unsigned stride, int receivers, int n) {
+    return 0;
+}
+
+static int pack_s24_simd(uint8_t *dst, const uint8_t *const *src, unsigned stride, int receivers, int n) {
+    return 0;
+}
+#endif
+
+void hpsdr_pack_s32(uint8_t *dst, const int32_t *const *src, unsigned stride, int receivers, int n) {
+    const int32_t *rest[8];
+    int j = use_simd ? pack_s32_simd(dst, src, stride, receivers, n) : 0;
+
+    if (j == n)
+        return;
+    for (int k = 0; k < receivers; k++)
+        rest[k] = src[k] + j * stride;
+    hpsdr_pack_s32_scalar(dst + j * (receivers * 6 + 2), rest, stride, receivers, n - j);
+}
+
+void hpsdr_pack_f32(uint8_t *dst, const float *const *src, unsigned stride, int receivers, int n) {
+    const float *rest[8];
+    int j = use_simd ? pack_f32_simd(dst, src, stride, receivers, n) : 0;
+
+    if (j == n)
+        return;
+    for (int k = 0; k < receivers; k++)
+        rest[k] = src[k] + j * stride;
+    hpsdr_pack_f32_scalar(dst + j * (receivers * 6 + 2), rest, stride, receivers, n - j);
+}
+
+void hpsdr_pack_s16(uint8_t *dst, const uint8_t *const *src, unsigned stride, int receivers, int n) {
+    const uint8_t *rest[8];
+    int j = use_simd ? pack_s16_simd(dst, src, stride, receivers, n) : 0;
+
+    if (j == n)
+        return;
+    for (int k = 0; k < receivers; k++)
+        rest[k] = src[k] + (size_t) j * stride;
+    hpsdr_pack_s16_scalar(dst + j * (receivers * 6 + 2), rest, stride, receivers, n - j);
+}
+
+void hpsdr_pack_s24(uint8_t *dst, const uint8_t *const *src, unsigned stride, int receivers, int n) {
+    const uint8_t *rest[8];
+    int j = use_simd ? pack_s24_simd(dst, src, stride, receivers, n) : 0;
+
+    if (j == n)
+        return;
+    for (int k = 0; k < receivers; k++)
+        rest[k] = src[k] + (size_t) j * stride;
+    hpsdr_pack_s24_scalar(dst + j * (receivers * 6 + 2), rest, stride, receivers, n - j);
+}
+
+const char* hpsdr_pack_kernel(void) {
+#if defined(__ARM_NEON)
+    return use_simd ? "neon" : "scalar";
+#elif defined(__SSE2__)
+    return use_simd ? "sse2" : "scalar";
+#else
+    return "scalar";
+#endif
+}
+
+// I/Q pairs for 8 receivers, 2 samples apart for the packed case and 6 for the strided one
+#define PACK_TEST_LEN (8 * 6 * 63)
+
+// every receiver count with contiguous and strided pairs, 24 bit extremes, rounding halves and
+// floats out of range; fall back to scalar on any difference
+int hpsdr_pack_init(void) {
+    int32_t *s32 = malloc(PACK_TEST_LEN * sizeof(int32_t));
+    float *f32 = malloc(PACK_TEST_LEN * sizeof(float));
+    const int32_t *s[8];
+    const float *f[8];
+    const uint8_t *b16[8], *b24[8];
+    uint8_t simd[504], ref[504];
+    uint32_t seed = 1;
+    int ret = 0;
+
+    if (s32 == NULL || f32 == NULL) {
+        free(s32);
+        free(f32);
+        return -1;
+    }
+
+    for (int n = 0; n < PACK_TEST_LEN; n++) {
+        seed = seed * 1664525 + 1013904223;
+        switch (n % 8) {
+        case 0:
+            s32[n] = 0x7fffff;
+            f32[n] = 1.5f;
+            break;
+        case 1:
+            s32[n] = -0x800000;
+            f32[n] = -1.5f;
+            break;
+        case 2:
+            s32[n] = (int32_t) seed >> 8;
+            f32[n] = ((int32_t) (seed >> 9) - 0x400000 + 0.5f) / PACK_SCALE;
+            break;
+        default:
+            s32[n] = (int32_t) seed >> 8;
+            f32[n] = (int32_t) seed * (1.0f / 2147483648.0f);
+            break;
+        }
+    }
+
+    for (int receivers = 1; receivers <= 8 && ret == 0; receivers++) {
+        int n = 504 / (receivers * 6 + 2);
+
+        for (unsigned stride = 2; stride <= 6; stride += 4) {
+            for (int k = 0; k < receivers; k++) {
+                s[k] = s32 + k * stride * 63 + (stride == 2 ? 0 : k % 3);
+                f[k] = f32 + k * stride * 63 + (stride == 2 ? 0 : k % 3);
+                // the same words read as 16 and 24 bit recordings
+                b16[k] = (const uint8_t*) s32 + 2 * (k * stride * 63 + (stride == 2 ? 0 : k % 3));
+                b24[k] = (const uint8_t*) s32 + 3 * (k * stride * 63 + (stride == 2 ? 0 : k % 3));
+            }
+            memset(simd, 0xa5, sizeof(simd));
+            memset(ref, 0xa5, sizeof(ref));
+            hpsdr_pack_s32(simd, s, stride, receivers, n);
+            hpsdr_pack_s32_scalar(ref, s, stride, receivers, n);
+            if (memcmp(simd, ref, sizeof(ref)) == 0) {
+                hpsdr_pack_f32(simd, f, stride, receivers, n);
+                hpsdr_pack_f32_scalar(ref, f, stride, receivers, n);
+            }
+            if (memcmp(simd, ref, sizeof(ref)) == 0) {
+                hpsdr_pack_s16(simd, b16, 2 * stride, receivers, n);
+                hpsdr_pack_s16_scalar(ref, b16, 2 * stride, receivers, n);
+            }
+            if (memcmp(simd, ref, sizeof(ref)) == 0) {
+                hpsdr_pack_s24(simd, b24, 3 * stride, receivers, n);
+                hpsdr_pack_s24_scalar(ref, b24, 3 * stride, receivers, n);
+            }
+            if (memcmp(simd, ref, sizeof(ref)) != 0) {
+                hpsdr_dbg_printf(0, "WARNING: %s ep6 packer differs from scalar (%d receivers), not used\n", hpsdr_pack_kernel(), receivers);
+                use_simd = false;
+                ret = -1;
+                break;
+            }
+        }
+    }
+
+    free(s32);
+    free(f32);
+    if (ret == 0)
+        hpsdr_dbg_printf(1, "ep6 sample packer: %s\n", hpsdr_pack_kernel());
+    return ret;
+}
+
+// one block of every sample format through the scalar or the selected kernel, ns per block
+static double pack_time(int format, bool vector, const void *const *src, int receivers, int n) {
+    uint8_t block[504];
+    const int runs = 2000;
+    uint64_t start = pack_now();
+
+    for (int r = 0; r < runs; r++) {
+        switch (format) {
+        case 0:
+            (vector ? hpsdr_pack_s16 : hpsdr_pack_s16_scalar)(block, (const uint8_t* const*) src, 4, receivers, n);
+            break;
+        case 1:
+            (vector ? hpsdr_pack_s24 : hpsdr_pack_s24_scalar)(block, (const uint8_t* const*) src, 6, receivers, n);
+            break;
+        case 2:
+            (vector ? hpsdr_pack_s32 : hpsdr_pack_s32_scalar)(block, (const int32_t* const*) src, 2, receivers, n);
+            break;
+        default:
+            (vector ? hpsdr_pack_f32 : hpsdr_pack_f32_scalar)(block, (const float* const*) src, 2, receivers, n);
+            break;
+        }
+        __asm__ volatile("" : : "r"(block) : "memory");  // keep the stores
+    }
+
+    return (double) (pack_now() - start) / runs;
+}
+
+// every receiver count, stereo recordings for the byte formats
+void hpsdr_pack_bench(void) {
+    int32_t *s32 = calloc(8 * 2 * 63, sizeof(int32_t));
+    float *f32 = calloc(8 * 2 * 63, sizeof(float));
+    const void *src[4][8];
+
+    if (s32 == NULL || f32 == NULL)
+        goto end;
+
+    for (int k = 0; k < 8; k++) {
+        src[0][k] = (const uint8_t*) s32 + k * 4 * 63;
+        src[1][k] = (const uint8_t*) s32 + k * 6 * 63;
+        src[2][k] = s32 + k * 2 * 63;
+        src[3][k] = f32 + k * 2 * 63;
+    }
+
+    hpsdr_dbg_printf(1, "ep6 packer benchmark (ns per block, s16 / s24 / s32 / f32):\n");
+    for (int receivers = 1; receivers <= 8; receivers++) {
+        int n = 504 / (receivers * 6 + 2);
+        double t[2][4];
+
+        for (int format = 0; format < 4; format++) {
+            t[0][format] = pack_time(format, false, src[format], receivers, n);
+            t[1][format] = pack_time(format, true, src[format], receivers, n);
+        }
+        hpsdr_dbg_printf(1, "  %d rx: scalar %6.1f / %6.1f / %6.1f / %6.1f, %s %6.1f / %6.1f / %6.1f / %6.1f\n", receivers, t[0][0], t[0][1],
+                t[0][2], t[0][3], hpsdr_pack_kernel(), t[1][0], t[1][1], t[1][2], t[1][3]);
+    }
+
+end:
+    free(s32);
+    free(f32);
+}
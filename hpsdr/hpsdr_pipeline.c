@@ -0,0 +1,332 @@
+/*
+ * Copyright 2021 Emiliano Gonzalez LU3VEA (lu3vea @ gmail . com))
+ * * Project Site: https://github.com/hiperiondev/hpsdr-p1-rpitx *
+ *
+ * This is based on other projects:
+ *    librpitx (https://github.com/F5OEO/librpitx)
+ *    HPSDR simulator (https://github.com/g0orx/pihpsdr)
+ *    small-memory XML config database library (https://github.com/dleonard0/mxml)
+ *
+ *    please contact their authors for more information.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ *
+ */
+
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+
+#include "hpsdr_debug.h"
+#include "hpsdr_main.h"
+#include "hpsdr_ep2.h"
+#include "hpsdr_ep6.h"
+#include "hpsdr_tx_samples.h"
+#include "hpsdr_pool.h"
+#include "hpsdr_queue.h"
+#include "hpsdr_pipeline.h"
+
+hpsdr_stage_t stages[STAGE_MAX] = {
+        { .name = "net rx" },
+        { .name = "decode" },
+        { .name = "tx dma" },
+        { .name = "ep6"    }
+};
+
+hpsdr_queue_t decode_queue;
+
+static pthread_t decode_id;
+static bool decode_run = false;
+static uint32_t seq_reset = 0;  // set by the network thread, taken by whoever decodes
+
+hpsdr_reorder_stats_t reorder_stats;
+
+// reorder window, decode side only: held frames keep their pool reference until released
+static hpsdr_pkt_t held[REORDER_SLOTS];
+static uint32_t held_seq[REORDER_SLOTS];
+static unsigned held_count = 0;
+static uint32_t next_seq;         // next sequence number to release
+static uint32_t max_seq;          // highest sequence number seen
+static bool seq_valid = false;
+static uint64_t gone = 0;         // bit (seq % 64) set while seq is concealed, tells late from duplicate
+
+uint64_t hpsdr_pipeline_now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void hpsdr_pipeline_account(hpsdr_stage_id_t id, uint64_t start, unsigned items) {
+    uint64_t busy = hpsdr_pipeline_now() - start;
+
+    stages[id].items += items;
+    stages[id].busy_ns += busy;
+    if (busy > stages[id].busy_max_ns)
+        stages[id].busy_max_ns = busy;
+}
+
+// pin the calling thread to the core configured for its stage
+void hpsdr_pipeline_pin(hpsdr_stage_id_t id) {
+    int cpu = config.pipeline.cpu[id];
+    cpu_set_t set;
+
+    if (cpu < 0)
+        return;
+
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+        hpsdr_dbg_printf(1, "Stage %s: can not pin to cpu %d\n", stages[id].name, cpu);
+        return;
+    }
+    hpsdr_dbg_printf(1, "Stage %s: pinned to cpu %d\n", stages[id].name, cpu);
+}
+
+static uint32_t ep2_seq(const uint8_t *buffer) {
+    return ((buffer[4] & 0xFF) << 24) + ((buffer[5] & 0xFF) << 16) + ((buffer[6] & 0xFF) << 8) + (buffer[7] & 0xFF);
+}
+
+// decode an ep2 frame in sequence order and drop its reference
+static void ep2_release(const hpsdr_pkt_t *pkt) {
+    uint8_t *buffer = hpsdr_pkt_data(pkt);
+
+    seqnum = ep2_seq(buffer);
+    last_seqnum = seqnum;
+    gone &= ~(1ULL << (seqnum & 63));
+
+    ep2_handler(buffer + 11);
+    ep2_handler(buffer + 523);
+
+    if (ep6_active()) {
+        samples_rcv(buffer);
+    }
+
+    hpsdr_pool_put(pkt->slot);
+}
+
+static bool reorder_held(uint32_t seq) {
+    unsigned idx = seq & (REORDER_SLOTS - 1);
+
+    return held[idx].slot >= 0 && held_seq[idx] == seq;
+}
+
+static void reorder_take(uint32_t seq) {
+    unsigned idx = seq & (REORDER_SLOTS - 1);
+
+    ep2_release(&held[idx]);
+    held[idx].slot = -1;
+    held_count--;
+}
+
+// a lost frame: its 126 tx samples are bridged towards the next frame we have, the stream keeps its length
+static void reorder_conceal(uint32_t seq, const uint8_t *trigger) {
+    const uint8_t *next = trigger;
+
+    for (uint32_t s = seq + 1; s != next_seq + REORDER_SLOTS; s++) {
+        if (reorder_held(s)) {
+            next = hpsdr_pkt_data(&held[s & (REORDER_SLOTS - 1)]);
+            break;
+        }
+    }
+
+    hpsdr_dbg_printf(1, "SEQ ERROR: %lu lost\n", (unsigned long) seq);
+    ++reorder_stats.lost;
+    gone |= 1ULL << (seq & 63);
+    if (ep6_active())
+        samples_conceal(next);
+}
+
+// release or conceal everything before seq
+static void reorder_advance(uint32_t seq, const uint8_t *trigger) {
+    for (; next_seq != seq; next_seq++) {
+        if (reorder_held(next_seq))
+            reorder_take(next_seq);
+        else
+            reorder_conceal(next_seq, trigger);
+    }
+}
+
+// release what is held in order, holes are not concealed (new stream or session)
+static void reorder_drain(bool release) {
+    for (uint32_t s = next_seq; held_count > 0; s++) {
+        if (!reorder_held(s))
+            continue;
+        if (release) {
+            reorder_take(s);
+        } else {
+            hpsdr_pool_put(held[s & (REORDER_SLOTS - 1)].slot);
+            held[s & (REORDER_SLOTS - 1)].slot = -1;
+            held_count--;
+        }
+    }
+}
+
+// put ep2 frames back in sequence order through a window of config.global.reorder frames
+static void decode_ep2(const hpsdr_pkt_t *pkt) {
+    uint8_t *buffer = hpsdr_pkt_data(pkt);
+    uint64_t start = hpsdr_pipeline_now();
+    uint32_t seq = ep2_seq(buffer);
+    int32_t d;
+
+    if (__atomic_exchange_n(&seq_reset, 0, __ATOMIC_ACQ_REL)) {
+        reorder_drain(false);
+        last_seqnum = 0xffffffff;
+        seq_valid = false;
+    }
+    if (!seq_valid) {
+        next_seq = max_seq = seq;
+        gone = 0;
+        seq_valid = true;
+    }
+
+    d = (int32_t) (seq - next_seq);
+    if (d < 0 && d > -REORDER_RESYNC) {
+        // behind the window: either concealed already or a copy of a released frame
+        if (d > -64 && (gone & (1ULL << (seq & 63))))
+            ++reorder_stats.late;
+        else
+            ++reorder_stats.duplicated;
+        hpsdr_pool_put(pkt->slot);
+        goto out;
+    }
+
+    if (d < 0 || d >= REORDER_RESYNC) {
+        hpsdr_dbg_printf(1, "SEQ ERROR: expected %lu, recvd %lu, resync\n", (unsigned long) next_seq, (unsigned long) seq);
+        ++reorder_stats.resyncs;
+        reorder_drain(true);
+        next_seq = max_seq = seq;
+    } else if (d > config.global.reorder) {
+        reorder_advance(seq - config.global.reorder, buffer);
+    }
+
+    if (reorder_held(seq)) {
+        ++reorder_stats.duplicated;
+        hpsdr_pool_put(pkt->slot);
+        goto out;
+    }
+    if ((int32_t) (seq - max_seq) < 0)
+        ++reorder_stats.reordered;
+    else
+        max_seq = seq;
+
+    held[seq & (REORDER_SLOTS - 1)] = *pkt;
+    held_seq[seq & (REORDER_SLOTS - 1)] = seq;
+    if (++held_count > reorder_stats.held_max)
+        reorder_stats.held_max = held_count;
+
+    while (held_count > 0 && reorder_held(next_seq))
+        reorder_take(next_seq++);
+
+out:
+    hpsdr_pipeline_account(STAGE_DECODE, start, 1);
+}
+
+static void* decode_stage(void *arg) {
+    hpsdr_pkt_t pkt;
+
+    hpsdr_pipeline_pin(STAGE_DECODE);
+
+    while (__atomic_load_n(&decode_run, __ATOMIC_ACQUIRE)) {
+        if (!hpsdr_queue_wait(&decode_queue, 100))
+            continue;
+        while (hpsdr_queue_pop(&decode_queue, &pkt))
+            decode_ep2(&pkt);
+    }
+
+    // whatever is left goes back to the pool
+    while (hpsdr_queue_pop(&decode_queue, &pkt))
+        hpsdr_pool_put(pkt.slot);
+
+    return NULL;
+}
+
+// the next decoded frame starts a new sequence
+void hpsdr_pipeline_seq_reset(void) {
+    __atomic_store_n(&seq_reset, 1, __ATOMIC_RELEASE);
+}
+
+// hand an ep2 frame to the decode stage, the caller's reference goes with it
+void hpsdr_pipeline_ep2(const hpsdr_pkt_t *pkt) {
+    if (!decode_run) {
+        decode_ep2(pkt);
+        return;
+    }
+
+    // a full queue means decode can not keep up: dropping here is what a late frame would cost anyway
+    if (!hpsdr_queue_push(&decode_queue, pkt))
+        hpsdr_pool_put(pkt->slot);
+}
+
+int hpsdr_pipeline_init(void) {
+    // the caller is the network stage
+    hpsdr_pipeline_pin(STAGE_NET);
+
+    for (int n = 0; n < REORDER_SLOTS; n++)
+        held[n].slot = -1;
+
+    if (!config.pipeline.enabled)
+        return 0;
+
+    if (hpsdr_queue_init(&decode_queue, config.pipeline.queue, sizeof(hpsdr_pkt_t)) < 0) {
+        hpsdr_dbg_printf(0, "ERROR: decode queue not allocated\n");
+        return -1;
+    }
+
+    decode_run = true;
+    if (pthread_create(&decode_id, NULL, decode_stage, NULL) != 0) {
+        hpsdr_dbg_printf(0, "ERROR: create decode thread\n");
+        decode_run = false;
+        hpsdr_queue_deinit(&decode_queue);
+        return -1;
+    }
+    hpsdr_dbg_printf(1, "Pipeline: decode stage with a %u packet queue\n", decode_queue.mask + 1);
+
+    return 0;
+}
+
+void hpsdr_pipeline_deinit(void) {
+    if (!decode_run)
+        return;
+
+    __atomic_store_n(&decode_run, false, __ATOMIC_RELEASE);
+    hpsdr_queue_wake(&decode_queue);
+    pthread_join(decode_id, NULL);
+    hpsdr_queue_deinit(&decode_queue);
+}
+
+void hpsdr_pipeline_print(void) {
+    int n;
+
+    hpsdr_dbg_printf(0, "----------------------- pipeline ------------------------\n");
+    for (n = 0; n < STAGE_MAX; n++) {
+        hpsdr_dbg_printf(0, "%15s = %llu items, %.2f us avg, %.2f us max, cpu %d\n", stages[n].name, (unsigned long long) stages[n].items,
+                stages[n].items ? (double) stages[n].busy_ns / stages[n].items / 1000.0 : 0.0, stages[n].busy_max_ns / 1000.0, config.pipeline.cpu[n]);
+    }
+    hpsdr_dbg_printf(0, "     ep2 window = %d frames (max %u held)\n", config.global.reorder, reorder_stats.held_max);
+    hpsdr_dbg_printf(0, "     ep2 frames = %llu reordered, %llu duplicated, %llu late\n", (unsigned long long) reorder_stats.reordered,
+            (unsigned long long) reorder_stats.duplicated, (unsigned long long) reorder_stats.late);
+    hpsdr_dbg_printf(0, "       ep2 lost = %llu (concealed), %llu resyncs\n", (unsigned long long) reorder_stats.lost,
+            (unsigned long long) reorder_stats.resyncs);
+    if (decode_run) {
+        hpsdr_dbg_printf(0, "   decode queue = %u (max %u of %u), %llu dropped\n", hpsdr_queue_depth(&decode_queue), decode_queue.depth_max,
+                decode_queue.mask + 1, (unsigned long long) decode_queue.drops);
+    }
+}
@@ -0,0 +1,167 @@
+/*
+ * Copyright 2021 Emiliano Gonzalez LU3VEA (lu3vea @ gmail . com))
+ * * Project Site: https://github.com/hiperiondev/hpsdr-p1-rpitx *
+ *
+ * This is based on other projects:
+ *    librpitx (https://github.com/F5OEO/librpitx)
+ *    HPSDR simulator (https://github.com/g0orx/pihpsdr)
+ *    small-memory XML config database library (https://github.com/dleonard0/mxml)
+ *
+ *    please contact their authors for more information.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ *
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+#include "hpsdr_debug.h"
+#include "hpsdr_pool.h"
+
+#define POOL_EMPTY 0xffffffffu
+
+static uint8_t *pool_mem = NULL;
+static uint32_t *pool_refs = NULL;
+static uint32_t *pool_next = NULL;
+static uint64_t pool_head;  // free stack: aba tag << 32 | first free slot
+static size_t pool_slot_size = 0;
+static unsigned pool_slots = 0;
+static int pool_fd = -1;            // eventfd: a slot came back while the receiver waited
+static bool pool_waiting = false;
+
+hpsdr_pool_stats_t pool_stats;
+
+int hpsdr_pool_init(unsigned slots, size_t slot_size) {
+    unsigned n;
+
+    pool_slot_size = (slot_size + POOL_ALIGN - 1) & ~(size_t) (POOL_ALIGN - 1);
+    pool_slots = slots;
+
+    if (posix_memalign((void**) &pool_mem, POOL_ALIGN, pool_slots * pool_slot_size) != 0) {
+        pool_mem = NULL;
+        return -1;
+    }
+    pool_refs = calloc(pool_slots, sizeof(uint32_t));
+    pool_next = calloc(pool_slots, sizeof(uint32_t));
+    pool_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (pool_refs == NULL || pool_next == NULL || pool_fd < 0) {
+        hpsdr_pool_deinit();
+        return -1;
+    }
+
+    for (n = 0; n < pool_slots; n++)
+        pool_next[n] = (n + 1 < pool_slots) ? n + 1 : POOL_EMPTY;
+    pool_head = 0;
+    pool_waiting = false;
+    memset(&pool_stats, 0, sizeof(pool_stats));
+
+    hpsdr_dbg_printf(1, "Packet pool: %u slots x %u bytes\n", pool_slots, (unsigned) pool_slot_size);
+
+    return 0;
+}
+
+void hpsdr_pool_deinit(void) {
+    free(pool_mem);
+    free(pool_refs);
+    free(pool_next);
+    if (pool_fd > -1)
+        close(pool_fd);
+    pool_fd = -1;
+    pool_mem = NULL;
+    pool_refs = NULL;
+    pool_next = NULL;
+    pool_slots = 0;
+}
+
+size_t hpsdr_pool_slot_size(void) {
+    return pool_slot_size;
+}
+
+unsigned hpsdr_pool_slots(void) {
+    return pool_slots;
+}
+
+int hpsdr_pool_event_fd(void) {
+    return pool_fd;
+}
+
+// ask for a wakeup on the event fd when the next slot comes back, false if one is free already
+bool hpsdr_pool_wait(void) {
+    __atomic_store_n(&pool_waiting, true, __ATOMIC_SEQ_CST);
+    if ((uint32_t) __atomic_load_n(&pool_head, __ATOMIC_SEQ_CST) != POOL_EMPTY) {
+        __atomic_store_n(&pool_waiting, false, __ATOMIC_RELAXED);
+        return false;
+    }
+
+    return true;
+}
+
+// take a free slot with one reference, -1 if the pool is exhausted
+int hpsdr_pool_get(void) {
+    uint64_t head, next;
+    uint32_t slot, used;
+
+    head = __atomic_load_n(&pool_head, __ATOMIC_ACQUIRE);
+    do {
+        slot = (uint32_t) head;
+        if (slot == POOL_EMPTY) {
+            __atomic_fetch_add(&pool_stats.exhausted, 1, __ATOMIC_RELAXED);
+            return -1;
+        }
+        next = ((head >> 32) + 1) << 32 | __atomic_load_n(&pool_next[slot], __ATOMIC_RELAXED);
+    } while (!__atomic_compare_exchange_n(&pool_head, &head, next, true, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+
+    pool_refs[slot] = 1;
+    __atomic_fetch_add(&pool_stats.gets, 1, __ATOMIC_RELAXED);
+    used = __atomic_add_fetch(&pool_stats.in_use, 1, __ATOMIC_RELAXED);
+    if (used > pool_stats.in_use_max)
+        pool_stats.in_use_max = used;
+
+    return (int) slot;
+}
+
+void hpsdr_pool_ref(int slot) {
+    __atomic_fetch_add(&pool_refs[slot], 1, __ATOMIC_RELAXED);
+}
+
+// drop a reference, the last one returns the slot to the free stack
+void hpsdr_pool_put(int slot) {
+    uint64_t head, next;
+
+    if (__atomic_sub_fetch(&pool_refs[slot], 1, __ATOMIC_ACQ_REL) != 0)
+        return;
+
+    __atomic_fetch_sub(&pool_stats.in_use, 1, __ATOMIC_RELAXED);
+    head = __atomic_load_n(&pool_head, __ATOMIC_ACQUIRE);
+    do {
+        __atomic_store_n(&pool_next[slot], (uint32_t) head, __ATOMIC_RELAXED);
+        next = ((head >> 32) + 1) << 32 | (uint32_t) slot;
+    } while (!__atomic_compare_exchange_n(&pool_head, &head, next, true, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+
+    // pairs with hpsdr_pool_wait: either it sees this slot or we see the waiter
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&pool_waiting, __ATOMIC_RELAXED) && __atomic_exchange_n(&pool_waiting, false, __ATOMIC_ACQ_REL))
+        eventfd_write(pool_fd, 1);
+}
+
+uint8_t* hpsdr_pool_data(int slot) {
+    return pool_mem + (size_t) slot * pool_slot_size;
+}
@@ -0,0 +1,120 @@
+/*
+ * Copyright 2021 Emiliano Gonzalez LU3VEA (lu3vea @ gmail . com))
+ * * Project Site: https://github.com/hiperiondev/hpsdr-p1-rpitx *
+ *
+ * This is based on other projects:
+ *    librpitx (https://github.com/F5OEO/librpitx)
+ *    HPSDR simulator (https://github.com/g0orx/pihpsdr)
+ *    small-memory XML config database library (https://github.com/dleonard0/mxml)
+ *
+ *    please contact their authors for more information.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ *
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hpsdr_futex.h"
+#include "hpsdr_queue.h"
+
+// capacity is rounded up to a power of two
+int hpsdr_queue_init(hpsdr_queue_t *q, unsigned capacity, size_t elem) {
+    unsigned size = 1;
+
+    while (size < capacity)
+        size <<= 1;
+
+    memset(q, 0, sizeof(*q));
+    if (posix_memalign((void**) &q->data, QUEUE_ALIGN, size * elem) != 0) {
+        q->data = NULL;
+        return -1;
+    }
+    q->mask = size - 1;
+    q->elem = elem;
+
+    return 0;
+}
+
+void hpsdr_queue_deinit(hpsdr_queue_t *q) {
+    free(q->data);
+    q->data = NULL;
+}
+
+// producer only
+bool hpsdr_queue_push(hpsdr_queue_t *q, const void *item) {
+    uint32_t tail = q->tail;
+    uint32_t depth = tail - __atomic_load_n(&q->head, __ATOMIC_ACQUIRE);
+
+    if (depth > q->mask) {
+        q->drops++;
+        return false;
+    }
+
+    memcpy(q->data + (tail & q->mask) * q->elem, item, q->elem);
+    __atomic_store_n(&q->tail, tail + 1, __ATOMIC_RELEASE);
+    if (depth + 1 > q->depth_max)
+        q->depth_max = depth + 1;
+
+    // full barrier pairs with the one in hpsdr_queue_wait: either the consumer sees the new tail or we see it sleeping
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&q->sleeping, __ATOMIC_RELAXED))
+        hpsdr_queue_wake(q);
+
+    return true;
+}
+
+// consumer only
+bool hpsdr_queue_pop(hpsdr_queue_t *q, void *item) {
+    uint32_t head = q->head;
+
+    if (head == __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE))
+        return false;
+
+    memcpy(item, q->data + (head & q->mask) * q->elem, q->elem);
+    __atomic_store_n(&q->head, head + 1, __ATOMIC_RELEASE);
+
+    return true;
+}
+
+// consumer only: block until the queue is not empty, a wake or the timeout (-1 waits forever)
+bool hpsdr_queue_wait(hpsdr_queue_t *q, int timeout_ms) {
+    uint32_t tail = __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE);
+
+    if (tail != q->head)
+        return true;
+
+    __atomic_store_n(&q->sleeping, 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    tail = __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE);
+    if (tail == q->head)
+        hpsdr_futex_wait(&q->tail, tail, timeout_ms);
+    __atomic_store_n(&q->sleeping, 0, __ATOMIC_RELAXED);
+
+    return __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE) != q->head;
+}
+
+// also used to get the consumer out of hpsdr_queue_wait when it should stop
+void hpsdr_queue_wake(hpsdr_queue_t *q) {
+    hpsdr_futex_wake(&q->tail);
+}
+
+uint32_t hpsdr_queue_depth(hpsdr_queue_t *q) {
+    return __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE) - __atomic_load_n(&q->head, __ATOMIC_ACQUIRE);
+}
@@ -0,0 +1,122 @@
+/*
+ * Copyright 2021 Emiliano Gonzalez LU3VEA (lu3vea @ gmail . com))
+ * * Project Site: https://github.com/hiperiondev/hpsdr-p1-rpitx *
+ *
+ * This is based on other projects:
+ *    librpitx (https://github.com/F5OEO/librpitx)
+ *    HPSDR simulator (https://github.com/g0orx/pihpsdr)
+ *    small-memory XML config database library (https://github.com/dleonard0/mxml)
+ *
+ *    please contact their authors for more information.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ *
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include <complex.h>
+
+#include "hpsdr_resample.h"
+
+#define RATE    48000.0
+#define LOCK    48      // blocks averaged before the loop closes
+#define ALPHA   0.0625  // fill low pass, per block
+#define OMEGA   0.1     // loop natural frequency, rad/s (about a minute)
+#define ZETA    0.7
+
+// the feeder is the only user, nothing here is shared
+hpsdr_resample_stats_t resample_stats;
+
+static double ratio = 1.0;         // input samples per output sample
+static double frac = 0.0;          // position of the next output between prev and in[0]
+static float _Complex prev = 0.0f; // last input sample of the previous block
+static double fill_avg;
+static double integral;            // drift estimate, as a ratio offset
+static unsigned locking;
+
+// start over: no correction, a new setpoint on the next LOCK blocks
+void hpsdr_resample_reset(void) {
+    ratio = 1.0;
+    frac = 0.0;
+    prev = 0.0f;
+    integral = 0.0;
+    locking = LOCK;
+    resample_stats.correction = 0.0;
+    resample_stats.ppm = 0.0;
+    ++resample_stats.locks;
+}
+
+// input samples the next n outputs will consume
+unsigned hpsdr_resample_need(unsigned n) {
+    return (unsigned) floor(frac + (n - 1) * ratio) + 1;
+}
+
+// linear interpolation over prev, in[0] .. in[need - 1], the phase carries over to the next block
+void hpsdr_resample_run(const float _Complex *in, float _Complex *out, unsigned n) {
+    unsigned need = hpsdr_resample_need(n);
+
+    for (unsigned k = 0; k < n; k++) {
+        double p = frac + k * ratio;
+        int i = (int) p;
+        float mu;
+        float _Complex a, b;
+
+        if (p < 0.0)
+            p = i = 0;
+        mu = p - i;
+        a = i == 0 ? prev : in[i - 1];
+        b = in[i];
+        out[k] = a + mu * (b - a);
+    }
+
+    prev = in[need - 1];
+    frac += n * ratio - need;
+}
+
+// PI loop on the ring fill seen before each block of n outputs (setpoint 0: hold the fill found at lock)
+void hpsdr_resample_control(unsigned fill, unsigned setpoint, unsigned n) {
+    const double kp = 2.0 * ZETA * OMEGA / RATE, ki = OMEGA * OMEGA / RATE, max = RESAMPLE_MAX_PPM * 1e-6;
+    double err, u;
+
+    if (locking > 0) {
+        fill_avg = locking == LOCK ? fill : fill_avg + (fill - fill_avg) / (LOCK - locking + 1);
+        if (--locking == 0)
+            resample_stats.setpoint = fill_avg;
+        return;
+    }
+    if (setpoint != 0)
+        resample_stats.setpoint = setpoint;
+
+    // the fill moves at RATE * (drift - u), kp and ki put the closed loop poles at OMEGA, ZETA
+    fill_avg += ALPHA * (fill - fill_avg);
+    err = fill_avg - resample_stats.setpoint;
+    integral += ki * err * n / RATE;
+    if (fabs(integral) > max)
+        integral = copysign(max, integral);
+
+    u = kp * err + integral;
+    if (fabs(u) >= max) {
+        u = copysign(max, u);
+        ++resample_stats.clamped;
+    }
+
+    ratio = 1.0 + u;
+    resample_stats.correction = u * 1e6;
+    resample_stats.ppm = integral * 1e6;
+}
@@ -0,0 +1,161 @@
+/*
+ * Copyright 2021 Emiliano Gonzalez LU3VEA (lu3vea @ gmail . com))
+ * * Project Site: https://github.com/hiperiondev/hpsdr-p1-rpitx *
+ *
+ * This is based on other projects:
+ *    librpitx (https://github.com/F5OEO/librpitx)
+ *    HPSDR simulator (https://github.com/g0orx/pihpsdr)
+ *    small-memory XML config database library (https://github.com/dleonard0/mxml)
+ *
+ *    please contact their authors for more information.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ *
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hpsdr_futex.h"
+#include "hpsdr_ring.h"
+
+// capacity is rounded up to a power of two
+int hpsdr_ring_init(hpsdr_ring_t *r, unsigned capacity, size_t elem) {
+    unsigned size = 1;
+
+    while (size < capacity)
+        size <<= 1;
+
+    memset(r, 0, sizeof(*r));
+    if (posix_memalign((void**) &r->data, RING_ALIGN, size * elem) != 0) {
+        r->data = NULL;
+        return -1;
+    }
+    r->size = size;
+    r->mask = size - 1;
+    r->elem = elem;
+
+    return 0;
+}
+
+void hpsdr_ring_deinit(hpsdr_ring_t *r) {
+    free(r->data);
+    r->data = NULL;
+}
+
+// copy n elements between the ring at index pos and buf, splitting the run at the wrap
+static void ring_copy(hpsdr_ring_t *r, uint32_t pos, void *buf, unsigned n, bool to_ring) {
+    uint32_t idx = pos & r->mask;
+    unsigned first = r->size - idx;
+    uint8_t *p = buf;
+
+    if (first > n)
+        first = n;
+
+    if (to_ring) {
+        memcpy(r->data + idx * r->elem, p, first * r->elem);
+        memcpy(r->data, p + first * r->elem, (n - first) * r->elem);
+    } else {
+        memcpy(p, r->data + idx * r->elem, first * r->elem);
+        memcpy(p + first * r->elem, r->data, (n - first) * r->elem);
+    }
+}
+
+// producer only: returns the number of elements stored, the rest is dropped
+unsigned hpsdr_ring_write(hpsdr_ring_t *r, const void *src, unsigned n) {
+    uint32_t tail = r->tail;
+    uint32_t fill = tail - __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+    uint32_t want;
+
+    if (n > r->size - fill) {
+        r->overruns += n - (r->size - fill);
+        n = r->size - fill;
+    }
+    if (n == 0)
+        return 0;
+
+    ring_copy(r, tail, (void*) src, n, true);
+    __atomic_store_n(&r->tail, tail + n, __ATOMIC_RELEASE);
+    fill += n;
+    if (fill > r->fill_max)
+        r->fill_max = fill;
+
+    // full barrier pairs with the one in hpsdr_ring_wait: either the consumer sees the new tail or we see it waiting
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    want = __atomic_load_n(&r->want, __ATOMIC_RELAXED);
+    if (want != 0 && fill >= want)
+        hpsdr_ring_wake(r);
+
+    return n;
+}
+
+// consumer only: all or nothing, a short ring is left untouched
+unsigned hpsdr_ring_read(hpsdr_ring_t *r, void *dst, unsigned n) {
+    uint32_t head = r->head;
+
+    if (__atomic_load_n(&r->tail, __ATOMIC_ACQUIRE) - head < n)
+        return 0;
+
+    ring_copy(r, head, dst, n, false);
+    __atomic_store_n(&r->head, head + n, __ATOMIC_RELEASE);
+
+    return n;
+}
+
+// consumer only: drop up to n of the oldest elements
+void hpsdr_ring_skip(hpsdr_ring_t *r, unsigned n) {
+    uint32_t head = r->head;
+    uint32_t fill = __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE) - head;
+
+    __atomic_store_n(&r->head, head + (n < fill ? n : fill), __ATOMIC_RELEASE);
+}
+
+// consumer only: drop everything written so far
+void hpsdr_ring_discard(hpsdr_ring_t *r) {
+    __atomic_store_n(&r->head, __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE), __ATOMIC_RELEASE);
+}
+
+// consumer only: block until n elements are available, a wake or the timeout (-1 waits forever)
+bool hpsdr_ring_wait(hpsdr_ring_t *r, unsigned n, int timeout_ms) {
+    uint32_t tail = __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+
+    if (tail - r->head >= n)
+        return true;
+
+    __atomic_store_n(&r->want, n, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    tail = __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+    if (tail - r->head < n)
+        hpsdr_futex_wait(&r->tail, tail, timeout_ms);
+    __atomic_store_n(&r->want, 0, __ATOMIC_RELAXED);
+
+    return __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE) - r->head >= n;
+}
+
+// also used to get the consumer out of hpsdr_ring_wait when it should stop
+void hpsdr_ring_wake(hpsdr_ring_t *r) {
+    hpsdr_futex_wake(&r->tail);
+}
+
+uint32_t hpsdr_ring_fill(hpsdr_ring_t *r) {
+    return __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE) - __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+}
+
+uint32_t hpsdr_ring_space(hpsdr_ring_t *r) {
+    return r->size - hpsdr_ring_fill(r);
+}
@@ -0,0 +1,107 @@
+/*
+ * Copyright 2021 Emiliano Gonzalez LU3VEA (lu3vea @ gmail . com))
+ * * Project Site: https://github.com/hiperiondev/hpsdr-p1-rpitx *
+ *
+ * This is based on other projects:
+ *    librpitx (https://github.com/F5OEO/librpitx)
+ *    HPSDR simulator (https://github.com/g0orx/pihpsdr)
+ *    small-memory XML config database library (https://github.com/dleonard0/mxml)
+ *
+ *    please contact their authors for more information.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ *
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "hpsdr_debug.h"
+#include "hpsdr_main.h"
+#include "hpsdr_rx.h"
+#include "hpsdr_pack.h"
+
+const hpsdr_rx_source_t *rx = NULL;
+hpsdr_rx_layout_t rx_layout;
+hpsdr_rx_stats_t rx_stats;
+
+static const char *formats[3] = {
+        "s16", //
+        "s24", //
+        "f32"  //
+        };
+
+const char* hpsdr_rx_format(rx_format_t format) {
+    return formats[format];
+}
+
+int hpsdr_rx_init(void) {
+    if (config.rx.source == RX_NONE)
+        return 0;
+
+    rx = &rx_file;
+    if (rx->open(&rx_layout) < 0) {
+        hpsdr_dbg_printf(0, "ERROR: can't open %s rx source\n", rx->name);
+        rx = NULL;
+        return -1;
+    }
+    hpsdr_dbg_printf(1, "RX source: %s (%s, %u channels)\n", rx->name, hpsdr_rx_format(rx_layout.format), rx_layout.channels);
+    if (config.global.bench)
+        hpsdr_pack_bench();
+
+    return 0;
+}
+
+void hpsdr_rx_deinit(void) {
+    if (rx != NULL)
+        rx->close();
+    rx = NULL;
+}
+
+// n samples of every receiver into a 504-byte block, straight from the source's memory
+void hpsdr_rx_pack(uint8_t *pointer, unsigned n, int receivers) {
+    unsigned width = rx_layout.stride / rx_layout.channels;
+    unsigned pairs = rx_layout.channels / 2;
+    hpsdr_rx_span_t span;
+    unsigned done = 0;
+
+    while (done < n) {
+        rx->peek(&span, n - done);
+        const uint8_t *in = span.data;
+
+        // every format goes through the vector packer, the pairs are channels samples apart
+        if (rx_layout.format == RX_F32) {
+            const float *src[8];
+
+            for (int k = 0; k < receivers; k++)
+                src[k] = (const float*) (in + (k % pairs) * 2 * width);
+            hpsdr_pack_f32(pointer, src, rx_layout.channels, receivers, span.frames);
+        } else {
+            const uint8_t *src[8];
+
+            for (int k = 0; k < receivers; k++)
+                src[k] = in + (k % pairs) * 2 * width;
+            if (rx_layout.format == RX_S16)
+                hpsdr_pack_s16(pointer, src, rx_layout.stride, receivers, span.frames);
+            else
+                hpsdr_pack_s24(pointer, src, rx_layout.stride, receivers, span.frames);
+        }
+        pointer += span.frames * (receivers * 6 + 2);
+        rx->consume(span.frames);
+        done += span.frames;
+    }
+    rx_stats.samples += n;
+}
@@ -0,0 +1,198 @@
+/*
+ * Copyright 2021 Emiliano Gonzalez LU3VEA (lu3vea @ gmail . com))
+ * * Project Site: https://github.com/hiperiondev/hpsdr-p1-rpitx *
+ *
+ * This is based on other projects:
+ *    librpitx (https://github.com/F5OEO/librpitx)
+ *    HPSDR simulator (https://github.com/g0orx/pihpsdr)
+ *    small-memory XML config database library (https://github.com/dleonard0/mxml)
+ *
+ *    please contact their authors for more information.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ *
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "hpsdr_debug.h"
+#include "hpsdr_main.h"
+#include "hpsdr_rx.h"
+
+#define WAVE_PCM        0x0001
+#define WAVE_FLOAT      0x0003
+#define WAVE_EXTENSIBLE 0xFFFE
+
+// recording mapped once, the ep6 thread reads the pages without syscalls and loops at the end
+static const uint8_t *map = NULL;
+static size_t map_len;
+static const uint8_t *data;
+static uint64_t frames;
+static uint64_t pos;
+static unsigned stride;
+
+static uint32_t le16(const uint8_t *p) {
+    return p[0] | p[1] << 8;
+}
+
+static uint32_t le32(const uint8_t *p) {
+    return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t) p[3] << 24;
+}
+
+// data chunk and format of a RIFF/WAVE file, -1 if it is not one we can play
+static int file_wave(hpsdr_rx_layout_t *layout, size_t *len) {
+    const uint8_t *p = map + 12;
+    const uint8_t *end = map + map_len;
+    unsigned tag = 0, bits = 0;
+
+    data = NULL;
+    *len = 0;
+    while (p + 8 <= end) {
+        uint32_t size = le32(p + 4);
+        const uint8_t *body = p + 8;
+
+        if (memcmp(p, "fmt ", 4) == 0 && size >= 16 && body + 16 <= end) {
+            tag = le16(body);
+            layout->channels = le16(body + 2);
+            layout->rate = le32(body + 4);
+            bits = le16(body + 14);
+            if (tag == WAVE_EXTENSIBLE && size >= 26 && body + 26 <= end)
+                tag = le16(body + 24);
+        } else if (memcmp(p, "data", 4) == 0) {
+            data = body;
+            *len = size < (size_t) (end - body) ? size : (size_t) (end - body);
+            break;
+        }
+        if (size > (size_t) (end - body))
+            break;
+        p = body + size + (size & 1);
+    }
+
+    if (tag == WAVE_PCM && bits == 16)
+        layout->format = RX_S16;
+    else if (tag == WAVE_PCM && bits == 24)
+        layout->format = RX_S24;
+    else if (tag == WAVE_FLOAT && bits == 32)
+        layout->format = RX_F32;
+    else {
+        hpsdr_dbg_printf(0, "ERROR: %s: wave format %u, %u bits not supported (16/24 bit pcm, 32 bit float)\n", config.rx.file, tag, bits);
+        return -1;
+    }
+    if (data == NULL) {
+        hpsdr_dbg_printf(0, "ERROR: %s: no data chunk\n", config.rx.file);
+        return -1;
+    }
+
+    return 0;
+}
+
+static int file_open(hpsdr_rx_layout_t *layout) {
+    static const unsigned width[3] = { 2, 3, 4 };
+    struct stat st;
+    size_t len;
+    int fd;
+
+    fd = open(config.rx.file, O_RDONLY);
+    if (fd < 0) {
+        hpsdr_dbg_printf(0, "ERROR: can't open %s\n", config.rx.file);
+        return -1;
+    }
+    if (fstat(fd, &st) < 0 || st.st_size == 0) {
+        hpsdr_dbg_printf(0, "ERROR: %s is empty\n", config.rx.file);
+        close(fd);
+        return -1;
+    }
+    map_len = st.st_size;
+    map = mmap(NULL, map_len, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        hpsdr_dbg_printf(0, "ERROR: can't map %s\n", config.rx.file);
+        map = NULL;
+        return -1;
+    }
+    madvise((void*) map, map_len, MADV_SEQUENTIAL | MADV_WILLNEED);
+
+    if (map_len >= 12 && memcmp(map, "RIFF", 4) == 0 && memcmp(map + 8, "WAVE", 4) == 0) {
+        if (file_wave(layout, &len) < 0)
+            goto fail;
+    } else {
+        // raw: layout from the config
+        data = map;
+        len = map_len;
+        layout->format = config.rx.format;
+        layout->channels = config.rx.channels;
+        layout->rate = 0;
+    }
+
+    if (layout->channels == 0 || layout->channels % 2) {
+        hpsdr_dbg_printf(0, "ERROR: %s: %u channels (need I/Q pairs)\n", config.rx.file, layout->channels);
+        goto fail;
+    }
+    stride = layout->channels * width[layout->format];
+    layout->stride = stride;
+    frames = len / stride;
+    pos = 0;
+    if (frames == 0) {
+        hpsdr_dbg_printf(0, "ERROR: %s: no samples\n", config.rx.file);
+        goto fail;
+    }
+
+    hpsdr_dbg_printf(1, "RX playback: %s, %llu samples", config.rx.file, (unsigned long long) frames);
+    if (layout->rate)
+        hpsdr_dbg_printf(1, " recorded at %u Hz (played at the negotiated rate)", layout->rate);
+    hpsdr_dbg_printf(1, "\n");
+
+    return 0;
+
+fail:
+    munmap((void*) map, map_len);
+    map = NULL;
+    return -1;
+}
+
+static void file_peek(hpsdr_rx_span_t *span, unsigned want) {
+    uint64_t left = frames - pos;
+
+    span->data = data + pos * stride;
+    span->frames = want < left ? want : left;
+}
+
+static void file_consume(unsigned n) {
+    pos += n;
+    if (pos >= frames) {
+        pos = 0;
+        rx_stats.loops++;
+    }
+}
+
+static void file_close(void) {
+    if (map != NULL)
+        munmap((void*) map, map_len);
+    map = NULL;
+}
+
+const hpsdr_rx_source_t rx_file = {
+        .name = "file",
+        .open = file_open,
+        .peek = file_peek,
+        .consume = file_consume,
+        .close = file_close
+};
@@ -0,0 +1,160 @@
+/*
+ * Copyright 2021 Emiliano Gonzalez LU3VEA (lu3vea @ gmail . com))
+ * * Project Site: https://github.com/hiperiondev/hpsdr-p1-rpitx *
+ *
+ * This is based on other projects:
+ *    librpitx (https://github.com/F5OEO/librpitx)
+ *    HPSDR simulator (https://github.com/g0orx/pihpsdr)
+ *    small-memory XML config database library (https://github.com/dleonard0/mxml)
+ *
+ *    please contact their authors for more information.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ *
+ */
+
+#include <stdint.h>
+#include <signal.h>
+#include <sys/resource.h>
+
+#include "hpsdr_debug.h"
+#include "hpsdr_main.h"
+#include "hpsdr_network.h"
+#include "hpsdr_pool.h"
+#include "hpsdr_pipeline.h"
+#include "hpsdr_ep6.h"
+#include "hpsdr_control.h"
+#include "hpsdr_iq_tx.h"
+#include "hpsdr_convert.h"
+#include "hpsdr_jitter.h"
+#include "hpsdr_resample.h"
+#include "hpsdr_dma.h"
+#include "hpsdr_rx.h"
+#include "hpsdr_pack.h"
+#include "hpsdr_flow.h"
+#include "hpsdr_stats.h"
+
+// set from the SIGUSR1 handler, serviced by the main loop
+volatile sig_atomic_t stats_request = 0;
+
+static double ratio(uint64_t num, uint64_t den) {
+    return den ? (double) num / (double) den : 0.0;
+}
+
+void hpsdr_stats_print(void) {
+    struct rusage ru;
+
+    hpsdr_dbg_printf(0, "[STATISTICS]\n");
+    // whole process, to compare run modes on the same board
+    if (getrusage(RUSAGE_SELF, &ru) == 0) {
+        hpsdr_dbg_printf(0, "----------------------- process -------------------------\n");
+        hpsdr_dbg_printf(0, "       run mode = %s\n", config.global.runmode == RUN_SINGLE ? "single" : "threaded");
+        hpsdr_dbg_printf(0, "       cpu user = %ld.%06ld s\n", (long) ru.ru_utime.tv_sec, (long) ru.ru_utime.tv_usec);
+        hpsdr_dbg_printf(0, "     cpu system = %ld.%06ld s\n", (long) ru.ru_stime.tv_sec, (long) ru.ru_stime.tv_usec);
+        hpsdr_dbg_printf(0, "   ctx switches = %ld voluntary, %ld involuntary\n", ru.ru_nvcsw, ru.ru_nivcsw);
+    }
+    hpsdr_dbg_printf(0, "----------------------- network -------------------------\n");
+    hpsdr_dbg_printf(0, "      rx frames = %llu\n", (unsigned long long) net_stats.rx_frames);
+    hpsdr_dbg_printf(0, "    rx syscalls = %llu (%.2f frames/syscall)\n", (unsigned long long) net_stats.rx_syscalls,
+            ratio(net_stats.rx_frames, net_stats.rx_syscalls));
+    hpsdr_dbg_printf(0, "      tx frames = %llu\n", (unsigned long long) net_stats.tx_frames);
+    hpsdr_dbg_printf(0, "    tx syscalls = %llu (%.2f frames/syscall)\n", (unsigned long long) net_stats.tx_syscalls,
+            ratio(net_stats.tx_frames, net_stats.tx_syscalls));
+    hpsdr_dbg_printf(0, "      tx errors = %llu\n", (unsigned long long) net_stats.tx_errors);
+    hpsdr_dbg_printf(0, "        wakeups = %llu\n", (unsigned long long) net_stats.wakeups);
+    hpsdr_dbg_printf(0, "----------------------- packet pool ---------------------\n");
+    hpsdr_dbg_printf(0, "          slots = %u x %u bytes\n", hpsdr_pool_slots(), (unsigned) hpsdr_pool_slot_size());
+    hpsdr_dbg_printf(0, "           gets = %llu\n", (unsigned long long) pool_stats.gets);
+    hpsdr_dbg_printf(0, "      exhausted = %llu\n", (unsigned long long) pool_stats.exhausted);
+    hpsdr_dbg_printf(0, "         in use = %u (max %u)\n", pool_stats.in_use, pool_stats.in_use_max);
+    hpsdr_dbg_printf(0, "----------------------- ep6 -----------------------------\n");
+    hpsdr_dbg_printf(0, "       sessions = %llu\n", (unsigned long long) ep6_stats.sessions);
+    hpsdr_dbg_printf(0, "  start latency = %.1f us avg, %.1f us max\n", ratio(ep6_stats.start_sum_ns, ep6_stats.sessions) / 1000.0,
+            ep6_stats.start_max_ns / 1000.0);
+    hpsdr_dbg_printf(0, "   stop latency = %.1f us avg, %.1f us max\n", ratio(ep6_stats.stop_sum_ns, ep6_stats.stops) / 1000.0,
+            ep6_stats.stop_max_ns / 1000.0);
+    hpsdr_dbg_printf(0, "      templates = %llu rebuilds\n", (unsigned long long) ep6_stats.rebuilds);
+    if (ep6_stats.rate > 0)
+        hpsdr_dbg_printf(0, "        rx rate = %u Hz nominal, %.1f Hz session (%+.1f ppm), %.1f Hz last second\n", ep6_stats.rate,
+                ep6_stats.rate_session, (ep6_stats.rate_session / ep6_stats.rate - 1.0) * 1e6, ep6_stats.rate_now);
+    hpsdr_dbg_printf(0, "         missed = %llu batches (late max %.2f ms)\n", (unsigned long long) ep6_stats.missed, ep6_stats.late_max_ns / 1e6);
+    hpsdr_dbg_printf(0, "        resyncs = %llu (%.1f ms skipped)\n", (unsigned long long) ep6_stats.resyncs, ep6_stats.skipped_ns / 1e6);
+    if (config.global.flowcontrol) {
+        hpsdr_dbg_printf(0, "    flow offset = %+.2f ppm (drift %+.2f ppm, %llu updates clamped)\n", flow_stats.ppm, flow_stats.drift,
+                (unsigned long long) flow_stats.clamped);
+        hpsdr_dbg_printf(0, "      flow fill = %.1f ms (setpoint %.1f ms, error %+.2f ms)\n", flow_stats.fill / 48.0, flow_stats.setpoint / 48.0,
+                flow_stats.error / 48.0);
+        hpsdr_dbg_printf(0, "   flow updates = %llu (%llu locks)\n", (unsigned long long) flow_stats.updates, (unsigned long long) flow_stats.locks);
+    }
+    if (rx != NULL) {
+        hpsdr_dbg_printf(0, "      rx source = %s (%s, %u channels, %s packer)\n", rx->name, hpsdr_rx_format(rx_layout.format), rx_layout.channels,
+                rx_layout.format == RX_F32 ? hpsdr_pack_kernel() : "scalar");
+        hpsdr_dbg_printf(0, "     rx samples = %llu per receiver (%llu loops)\n", (unsigned long long) rx_stats.samples,
+                (unsigned long long) rx_stats.loops);
+    }
+    hpsdr_dbg_printf(0, "----------------------- tx ------------------------------\n");
+    hpsdr_dbg_printf(0, "        iq ring = %u samples x %u bytes (%u KiB, %s)\n", iq_ring.size, (unsigned) iq_ring.elem,
+            (unsigned) (iq_ring.size * iq_ring.elem / 1024), config.tx.compact ? "int16" : "float");
+    hpsdr_dbg_printf(0, "      dma block = %u KiB\n", (unsigned) (config.global.iqburst * sizeof(float _Complex) / 1024));
+    hpsdr_dbg_printf(0, "           fill = %u (max %u)\n", hpsdr_ring_fill(&iq_ring), iq_ring.fill_max);
+    hpsdr_dbg_printf(0, "       overruns = %llu samples\n", (unsigned long long) iq_ring.overruns);
+    hpsdr_dbg_printf(0, "          depth = %.1f ms\n", hpsdr_ring_fill(&iq_ring) / 48.0);
+    if (config.global.runmode == RUN_THREADED) {
+        hpsdr_dbg_printf(0, " feeder wakeups = %llu (%llu idle), %.1f ms cpu\n", (unsigned long long) tx_stats.wakeups,
+                (unsigned long long) tx_stats.idle_wakeups, tx_stats.cpu_ns / 1e6);
+    }
+    hpsdr_dbg_printf(0, "   tx underruns = %llu (%.1f ms concealed, %llu samples recovered)\n", (unsigned long long) tx_stats.underruns,
+            tx_stats.concealed / 48.0, (unsigned long long) tx_stats.recovered);
+    if (config.tx.jitterbuffer) {
+        hpsdr_dbg_printf(0, "         jitter = %u ms (p%d)\n", jitter_stats.jitter_ms, config.tx.jitterpercentile);
+        hpsdr_dbg_printf(0, "   depth target = %.1f ms (underrun floor %u ms)\n", jitter_stats.target / 48.0, jitter_stats.floor_ms);
+        hpsdr_dbg_printf(0, "      underruns = %llu\n", (unsigned long long) jitter_stats.underruns);
+        hpsdr_dbg_printf(0, "        trimmed = %llu samples\n", (unsigned long long) jitter_stats.trimmed);
+        hpsdr_dbg_printf(0, "        resyncs = %llu\n", (unsigned long long) jitter_stats.resyncs);
+    }
+    if (config.tx.interpolation > 1) {
+        hpsdr_dbg_printf(0, "  interpolation = %ux, %u taps/phase (dma at %u Hz)\n", tx_interp.factor, tx_interp.taps, 48000 * tx_interp.factor);
+        hpsdr_dbg_printf(0, "    interp cost = %.1f us/block avg, %.1f us max (%.1f%% cpu)\n", ratio(tx_interp.busy_ns, tx_interp.runs) / 1000.0,
+                tx_interp.busy_max_ns / 1000.0, 100.0 * ratio(tx_interp.busy_ns, tx_interp.runs) / iqsender_block_time());
+    }
+    if (config.tx.resample) {
+        hpsdr_dbg_printf(0, "   clock offset = %+.1f ppm (host vs dma)\n", resample_stats.ppm);
+        hpsdr_dbg_printf(0, "     correction = %+.1f ppm\n", resample_stats.correction);
+        hpsdr_dbg_printf(0, "       setpoint = %.1f ms\n", resample_stats.setpoint / 48.0);
+        hpsdr_dbg_printf(0, "          locks = %llu (%llu blocks clamped)\n", (unsigned long long) resample_stats.locks,
+                (unsigned long long) resample_stats.clamped);
+    }
+    hpsdr_dbg_printf(0, "     convert in = %.2f ns/sample (%s)\n", ratio(tx_stats.in_convert_ns, tx_stats.in_samples), hpsdr_convert_kernel());
+    hpsdr_dbg_printf(0, "    convert out = %.2f ns/sample\n", ratio(tx_stats.out_convert_ns, tx_stats.out_samples));
+    hpsdr_dbg_printf(0, "   fast retunes = %llu\n", (unsigned long long) tx_stats.fast_retunes);
+    hpsdr_dbg_printf(0, "backend retunes = %llu\n", (unsigned long long) tx_stats.backend_retunes);
+    hpsdr_dbg_printf(0, "   full retunes = %llu\n", (unsigned long long) tx_stats.full_retunes);
+    hpsdr_dbg_printf(0, "------------------------- dma ---------------------------\n");
+    hpsdr_dbg_printf(0, "        backend = %s\n", dma->name);
+    hpsdr_dbg_printf(0, "         pushes = %llu (%llu samples)\n", (unsigned long long) dma_stats.pushes, (unsigned long long) dma_stats.samples);
+    if (dma == &dma_virtual) {
+        hpsdr_dbg_printf(0, "     fifo level = %lld samples\n", (long long) dma_stats.level);
+        hpsdr_dbg_printf(0, "      underruns = %llu (%.1f ms starved)\n", (unsigned long long) dma_stats.underruns,
+                dma_stats.starved / (48.0 * config.tx.interpolation));
+        hpsdr_dbg_printf(0, "       overruns = %llu (waits for fifo room)\n", (unsigned long long) dma_stats.overruns);
+    }
+    hpsdr_dbg_printf(0, "----------------------- control -------------------------\n");
+    hpsdr_dbg_printf(0, "retune requests = %llu\n", (unsigned long long) ctl_stats.retune_requests);
+    hpsdr_dbg_printf(0, "        retunes = %llu (max %.1f ms)\n", (unsigned long long) ctl_stats.retunes, ctl_stats.retune_max_ns / 1e6);
+    hpsdr_dbg_printf(0, "       commands = %llu (%llu dropped)\n", (unsigned long long) ctl_stats.commands, (unsigned long long) ctl_stats.dropped);
+    hpsdr_pipeline_print();
+    hpsdr_dbg_printf(0, "[END STATISTICS]\n\n");
+}
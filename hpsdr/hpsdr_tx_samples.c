@@ -38,44 +38,71 @@
 #include "hpsdr_debug.h"
 #include "librpitx.h"
 #include "hpsdr_protocol.h"
+#include "hpsdr_iq_tx.h"
+#include "hpsdr_convert.h"
+#include "hpsdr_pipeline.h"
 
-uint8_t *bp;
-int j;
-int16_t samplei, sampleq;
-int tx_iq_ptr = 0;
-int burst_cnt = 0;
 int CplxSampleNumber = 0;
 float _Complex *CIQBuffer;
 int ciqbuffer_ptr = 0;
 int Harmonic = 1;
 
+static float _Complex last_sample = 0.0f;  // last sample put in the ring, concealment starts from it
+
 void samples_rcv(uint8_t *buffer) {
     // Put TX IQ samples into the ring buffer
     // In the old protocol, samples come in groups of 8 bytes L1 L0 R1 R0 I1 I0 Q1 Q0
     // Here, L1/L0 and R1/R0 are audio samples, and I1/I0 and Q1/Q0 are the TX iq samples
     // I1 contains bits 8-15 and I0 bits 0-7 of a signed 16-bit integer. We convert this
-    // here to double.
-    double disample, dqsample;
-    bp = buffer + 16;  // skip 8 header and 8 SYNC/C&C bytes
+    // here to float, or just to native endian int16 when the ring is compact.
+    uint64_t start = hpsdr_pipeline_now();
+
+    if (config.tx.compact) {
+        int16_t samples[2 * 126];
+
+        hpsdr_convert_iq16(buffer + 16, samples, 63);
+        hpsdr_convert_iq16(buffer + 528, samples + 2 * 63, 63);
+        tx_stats.in_convert_ns += hpsdr_pipeline_now() - start;
+        tx_stats.in_samples += 126;
+        last_sample = (samples[2 * 125] + samples[2 * 125 + 1] * I) * CONVERT_SCALE;
+        iqsender_write16(samples, 126);
+    } else {
+        float _Complex samples[126];
+
+        hpsdr_convert_iq(buffer + 16, samples, 63);        // skip 8 header and 8 SYNC/C&C bytes
+        hpsdr_convert_iq(buffer + 528, samples + 63, 63);  // second block behind its own 8 SYNC/C&C bytes
+        tx_stats.in_convert_ns += hpsdr_pipeline_now() - start;
+        tx_stats.in_samples += 126;
+        last_sample = samples[125];
+        iqsender_write(samples, 126);
+    }
+}
+
+// stand-in for a lost frame: 126 samples on a line from the last sample to the first of next (NULL: fade to zero)
+void samples_conceal(const uint8_t *next) {
+    float _Complex target = 0.0f, step;
+
+    if (next != NULL)
+        hpsdr_convert_iq_scalar(next + 16, &target, 1);
+    step = (target - last_sample) / 127.0f;
 
-    for (j = 0; j < 126; j++) {
-        bp += 4;
-        samplei = (int) ((signed char) *bp++) << 8;
-        samplei |= (int) ((signed char) *bp++ & 0xFF);
-        disample = samplei * 0.000030518509476;
-        sampleq = (int) ((signed char) *bp++) << 8;
-        sampleq |= (int) ((signed char) *bp++ & 0xFF);
-        dqsample = sampleq * 0.000030518509476;
-        tx_arg.iq_buffer[tx_iq_ptr++] = disample + dqsample * I;
+    if (config.tx.compact) {
+        int16_t samples[2 * 126];
 
-        if (tx_iq_ptr > TXLEN * config.global.iqburst)
-            tx_iq_ptr = 0;
+        for (int j = 0; j < 126; j++) {
+            float _Complex v = last_sample + step * (j + 1);
 
-        if ((tx_iq_ptr % config.global.iqburst) == 0)
-            ++burst_cnt;
+            samples[2 * j] = lrintf(crealf(v) / CONVERT_SCALE);
+            samples[2 * j + 1] = lrintf(cimagf(v) / CONVERT_SCALE);
+        }
+        iqsender_write16(samples, 126);
+    } else {
+        float _Complex samples[126];
 
-        if (j == 62)
-            bp += 8;  // skip 8 SYNC/C&C bytes of second block
+        for (int j = 0; j < 126; j++)
+            samples[j] = last_sample + step * (j + 1);
+        iqsender_write(samples, 126);
     }
 
+    last_sample = last_sample + step * 126;
 }
@@ -0,0 +1,252 @@
+/*
+ * Copyright 2021 Emiliano Gonzalez LU3VEA (lu3vea @ gmail . com))
+ * * Project Site: https://github.com/hiperiondev/hpsdr-p1-rpitx *
+ *
+ * This is based on other projects:
+ *    librpitx (https://github.com/F5OEO/librpitx)
+ *    HPSDR simulator (https://github.com/g0orx/pihpsdr)
+ *    small-memory XML config database library (https://github.com/dleonard0/mxml)
+ *
+ *    please contact their authors for more information.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ *
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include "hpsdr_uring.h"
+
+#if HPSDR_HAVE_URING
+
+static int sys_io_uring_setup(unsigned entries, struct io_uring_params *p) {
+    return (int) syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return (int) syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static int sys_io_uring_register(int fd, unsigned opcode, void *arg, unsigned nr_args) {
+    return (int) syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+int hpsdr_uring_init(hpsdr_uring_t *ring, unsigned entries, unsigned cq_entries) {
+    struct io_uring_params p;
+
+    memset(ring, 0, sizeof(*ring));
+    memset(&p, 0, sizeof(p));
+    ring->fd = -1;
+
+    if (cq_entries > 0) {
+        p.flags |= IORING_SETUP_CQSIZE;
+        p.cq_entries = cq_entries;
+    }
+
+    if ((ring->fd = sys_io_uring_setup(entries, &p)) < 0)
+        return -1;
+
+    ring->sq_len = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    ring->cq_len = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        if (ring->cq_len > ring->sq_len)
+            ring->sq_len = ring->cq_len;
+        ring->cq_len = ring->sq_len;
+    }
+
+    ring->sq_ptr = mmap(NULL, ring->sq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+    if (ring->sq_ptr == MAP_FAILED)
+        goto fail;
+
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        ring->cq_ptr = ring->sq_ptr;
+    } else {
+        ring->cq_ptr = mmap(NULL, ring->cq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+        if (ring->cq_ptr == MAP_FAILED)
+            goto fail;
+    }
+
+    ring->sqes_len = p.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED)
+        goto fail;
+
+    ring->sq_head = (unsigned*) ((uint8_t*) ring->sq_ptr + p.sq_off.head);
+    ring->sq_tail = (unsigned*) ((uint8_t*) ring->sq_ptr + p.sq_off.tail);
+    ring->sq_array = (unsigned*) ((uint8_t*) ring->sq_ptr + p.sq_off.array);
+    ring->sq_mask = *(unsigned*) ((uint8_t*) ring->sq_ptr + p.sq_off.ring_mask);
+    ring->sq_entries = p.sq_entries;
+    ring->sq_local_tail = *ring->sq_tail;
+
+    ring->cq_head = (unsigned*) ((uint8_t*) ring->cq_ptr + p.cq_off.head);
+    ring->cq_tail = (unsigned*) ((uint8_t*) ring->cq_ptr + p.cq_off.tail);
+    ring->cq_mask = *(unsigned*) ((uint8_t*) ring->cq_ptr + p.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe*) ((uint8_t*) ring->cq_ptr + p.cq_off.cqes);
+
+    return 0;
+
+fail:
+    hpsdr_uring_deinit(ring);
+    return -1;
+}
+
+void hpsdr_uring_deinit(hpsdr_uring_t *ring) {
+    if (ring->br != NULL && ring->br != MAP_FAILED)
+        munmap(ring->br, ring->br_len);
+    if (ring->sqes != NULL && ring->sqes != MAP_FAILED)
+        munmap(ring->sqes, ring->sqes_len);
+    if (ring->cq_ptr != NULL && ring->cq_ptr != MAP_FAILED && ring->cq_ptr != ring->sq_ptr)
+        munmap(ring->cq_ptr, ring->cq_len);
+    if (ring->sq_ptr != NULL && ring->sq_ptr != MAP_FAILED)
+        munmap(ring->sq_ptr, ring->sq_len);
+    if (ring->fd > -1)
+        close(ring->fd);
+    memset(ring, 0, sizeof(*ring));
+    ring->fd = -1;
+}
+
+struct io_uring_sqe* hpsdr_uring_get_sqe(hpsdr_uring_t *ring) {
+    struct io_uring_sqe *sqe;
+    unsigned head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+    unsigned idx;
+
+    if (ring->sq_local_tail - head >= ring->sq_entries)
+        return NULL;
+
+    idx = ring->sq_local_tail & ring->sq_mask;
+    sqe = &ring->sqes[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    ring->sq_array[idx] = idx;
+    ring->sq_local_tail++;
+    ring->to_submit++;
+
+    return sqe;
+}
+
+// publish the queued sqes and optionally wait for wait_nr completions
+int hpsdr_uring_submit(hpsdr_uring_t *ring, unsigned wait_nr) {
+    unsigned n = ring->to_submit;
+    int ret;
+
+    __atomic_store_n(ring->sq_tail, ring->sq_local_tail, __ATOMIC_RELEASE);
+    ring->to_submit = 0;
+
+    do {
+        ret = sys_io_uring_enter(ring->fd, n, wait_nr, wait_nr ? IORING_ENTER_GETEVENTS : 0);
+    } while (ret < 0 && errno == EINTR);
+
+    return ret < 0 ? -errno : ret;
+}
+
+struct io_uring_cqe* hpsdr_uring_peek_cqe(hpsdr_uring_t *ring) {
+    unsigned head = *ring->cq_head;
+    unsigned tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+
+    if (head == tail)
+        return NULL;
+
+    return &ring->cqes[head & ring->cq_mask];
+}
+
+void hpsdr_uring_cqe_seen(hpsdr_uring_t *ring) {
+    __atomic_store_n(ring->cq_head, *ring->cq_head + 1, __ATOMIC_RELEASE);
+}
+
+// entries must be a power of two
+int hpsdr_uring_pbuf_init(hpsdr_uring_t *ring, uint16_t bgid, unsigned entries) {
+    struct io_uring_buf_reg reg;
+
+    ring->br_len = entries * sizeof(struct io_uring_buf);
+    ring->br = mmap(NULL, ring->br_len, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+    if (ring->br == MAP_FAILED) {
+        ring->br = NULL;
+        return -1;
+    }
+
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uint64_t) (uintptr_t) ring->br;
+    reg.ring_entries = entries;
+    reg.bgid = bgid;
+    if (sys_io_uring_register(ring->fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        munmap(ring->br, ring->br_len);
+        ring->br = NULL;
+        return -1;
+    }
+
+    ring->br_mask = entries - 1;
+    ring->br_tail = 0;
+    ring->br->tail = 0;
+
+    return 0;
+}
+
+// queue a buffer for the kernel, made visible by hpsdr_uring_pbuf_advance()
+void hpsdr_uring_pbuf_add(hpsdr_uring_t *ring, void *addr, unsigned len, uint16_t bid) {
+    struct io_uring_buf *buf = &ring->br->bufs[ring->br_tail & ring->br_mask];
+
+    buf->addr = (uint64_t) (uintptr_t) addr;
+    buf->len = len;
+    buf->bid = bid;
+    ring->br_tail++;
+}
+
+void hpsdr_uring_pbuf_advance(hpsdr_uring_t *ring) {
+    __atomic_store_n(&ring->br->tail, (uint16_t) ring->br_tail, __ATOMIC_RELEASE);
+}
+
+#else
+
+int hpsdr_uring_init(hpsdr_uring_t *ring, unsigned entries, unsigned cq_entries) {
+    memset(ring, 0, sizeof(*ring));
+    ring->fd = -1;
+    errno = ENOSYS;
+    return -1;
+}
+
+void hpsdr_uring_deinit(hpsdr_uring_t *ring) {
+}
+
+struct io_uring_sqe* hpsdr_uring_get_sqe(hpsdr_uring_t *ring) {
+    return NULL;
+}
+
+int hpsdr_uring_submit(hpsdr_uring_t *ring, unsigned wait_nr) {
+    return -ENOSYS;
+}
+
+struct io_uring_cqe* hpsdr_uring_peek_cqe(hpsdr_uring_t *ring) {
+    return NULL;
+}
+
+void hpsdr_uring_cqe_seen(hpsdr_uring_t *ring) {
+}
+
+int hpsdr_uring_pbuf_init(hpsdr_uring_t *ring, uint16_t bgid, unsigned entries) {
+    return -1;
+}
+
+void hpsdr_uring_pbuf_add(hpsdr_uring_t *ring, void *addr, unsigned len, uint16_t bid) {
+}
+
+void hpsdr_uring_pbuf_advance(hpsdr_uring_t *ring) {
+}
+
+#endif
@@ -0,0 +1,57 @@
+/*
+ * Copyright 2021 Emiliano Gonzalez LU3VEA (lu3vea @ gmail . com))
+ * * Project Site: https://github.com/hiperiondev/hpsdr-p1-rpitx *
+ *
+ * This is based on other projects:
+ *    librpitx (https://github.com/F5OEO/librpitx)
+ *    HPSDR simulator (https://github.com/g0orx/pihpsdr)
+ *    small-memory XML config database library (https://github.com/dleonard0/mxml)
+ *
+ *    please contact their authors for more information.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ *
+ */
+
+#ifndef HPSDR_CONTROL_H_
+#define HPSDR_CONTROL_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <netinet/in.h>
+
+typedef enum {
+    CTL_PROGRAM, //
+    CTL_ERASE,   //
+    CTL_SETIP    //
+} hpsdr_ctl_type_t;
+
+typedef struct hpsdr_control_stats {
+    uint64_t retune_requests;  // tx frequency changes seen
+    uint64_t retunes;          // iqsender_set() runs, after coalescing
+    uint64_t retune_max_ns;    // longest of them
+    uint64_t commands;         // program/erase/set ip handled
+    uint64_t dropped;          // commands lost to a full queue
+} hpsdr_control_stats_t;
+
+extern hpsdr_control_stats_t ctl_stats;
+
+ int hpsdr_control_init(void);
+void hpsdr_control_deinit(void);
+void hpsdr_control_retune(void);
+void hpsdr_control_post(hpsdr_ctl_type_t type, const uint8_t *packet, size_t len, const struct sockaddr_in *from);
+
+#endif /* HPSDR_CONTROL_H_ */
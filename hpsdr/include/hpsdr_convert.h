@@ -0,0 +1,47 @@
+/*
+ * Copyright 2021 Emiliano Gonzalez LU3VEA (lu3vea @ gmail . com))
+ * * Project Site: https://github.com/hiperiondev/hpsdr-p1-rpitx *
+ *
+ * This is based on other projects:
+ *    librpitx (https://github.com/F5OEO/librpitx)
+ *    HPSDR simulator (https://github.com/g0orx/pihpsdr)
+ *    small-memory XML config database library (https://github.com/dleonard0/mxml)
+ *
+ *    please contact their authors for more information.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ *
+ */
+
+#ifndef HPSDR_CONVERT_H_
+#define HPSDR_CONVERT_H_
+
+#include <stdint.h>
+#include <complex.h>
+
+// scale of the 16 bit ep2 tx samples (1 / 32767)
+#define CONVERT_SCALE 0.000030518509476f
+
+         int hpsdr_convert_init(void);
+const char* hpsdr_convert_kernel(void);
+        void hpsdr_convert_iq_scalar(const uint8_t *src, float _Complex *dst, int n);
+        void hpsdr_convert_iq(const uint8_t *src, float _Complex *dst, int n);
+        void hpsdr_convert_iq16_scalar(const uint8_t *src, int16_t *dst, int n);
+        void hpsdr_convert_iq16(const uint8_t *src, int16_t *dst, int n);
+        void hpsdr_convert_s16_scalar(const int16_t *src, float _Complex *dst, int n);
+        void hpsdr_convert_s16(const int16_t *src, float _Complex *dst, int n);
+
+#endif /* HPSDR_CONVERT_H_ */
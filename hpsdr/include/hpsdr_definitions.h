@@ -35,6 +35,37 @@ typedef enum {
     I2C  //
 } filter_type_t;
 
+typedef enum {
+    NET_SOCKET, //
+    NET_IOURING //
+} net_backend_t;
+
+typedef enum {
+    DMA_RPITX,  //
+    DMA_VIRTUAL //
+} dma_backend_t;
+
+typedef enum {
+    RX_NONE, //
+    RX_FILE  //
+} rx_source_type_t;
+
+typedef enum {
+    RX_S16, //
+    RX_S24, //
+    RX_F32  //
+} rx_format_t;
+
+typedef enum {
+    RUN_THREADED, //
+    RUN_SINGLE    //
+} run_mode_t;
+
+typedef enum {
+    CATCHUP_BURST, //
+    CATCHUP_SKIP   //
+} catchup_t;
+
 // devices
 typedef enum {
     DEVICE_METIS        = 0,    //
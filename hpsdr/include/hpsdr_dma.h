@@ -0,0 +1,62 @@
+/*
+ * Copyright 2021 Emiliano Gonzalez LU3VEA (lu3vea @ gmail . com))
+ * * Project Site: https://github.com/hiperiondev/hpsdr-p1-rpitx *
+ *
+ * This is based on other projects:
+ *    librpitx (https://github.com/F5OEO/librpitx)
+ *    HPSDR simulator (https://github.com/g0orx/pihpsdr)
+ *    small-memory XML config database library (https://github.com/dleonard0/mxml)
+ *
+ *    please contact their authors for more information.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ *
+ */
+
+#ifndef HPSDR_DMA_H_
+#define HPSDR_DMA_H_
+
+#include <stdint.h>
+#include <complex.h>
+
+#include "hpsdr_definitions.h"
+
+// where the tx samples go: librpitx or a stand-in with the same timing
+typedef struct hpsdr_dma_backend {
+    const char *name;
+     int (*init)(uint64_t frequency, int samplerate, int fifosize);
+     int (*set_frequency)(uint64_t frequency);  // < 0: not in place, deinit/init instead
+    void (*push)(float _Complex *samples, int len);  // blocks while the fifo is full
+    void (*deinit)(void);
+} hpsdr_dma_backend_t;
+
+typedef struct hpsdr_dma_stats {
+    uint64_t pushes;
+    uint64_t samples;
+    uint64_t underruns;   // virtual: the fifo ran dry between two pushes
+    uint64_t starved;     // virtual: samples the output went without
+    uint64_t overruns;    // virtual: pushes that found the fifo full and had to wait
+    int64_t level;        // virtual: fifo fill after the last push
+} hpsdr_dma_stats_t;
+
+extern const hpsdr_dma_backend_t *dma;
+extern const hpsdr_dma_backend_t dma_rpitx;
+extern const hpsdr_dma_backend_t dma_virtual;
+extern hpsdr_dma_stats_t dma_stats;
+
+void hpsdr_dma_select(dma_backend_t type);
+
+#endif /* HPSDR_DMA_H_ */
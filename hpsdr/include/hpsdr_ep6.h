@@ -29,6 +29,49 @@
 #ifndef HPSDR_EP6_H_
 #define HPSDR_EP6_H_
 
-void* ep6_handler(void *arg);
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef enum {
+    EP6_IDLE,     // no session
+    EP6_STARTING, // start requested, worker setting up
+    EP6_RUNNING,  // frames flowing
+    EP6_STOPPING, // stop requested, worker tearing down
+    EP6_EXIT      // worker ends
+} ep6_state_t;
+
+typedef struct hpsdr_ep6_stats {
+    uint64_t sessions;
+    uint64_t start_sum_ns;  // request to first frame built
+    uint64_t start_max_ns;
+    uint64_t stops;
+    uint64_t stop_sum_ns;   // request to last frame
+    uint64_t stop_max_ns;
+    uint64_t rebuilds;      // frame templates rebuilt after a settings change
+    uint32_t rate;          // nominal receiver sample rate
+    uint64_t session_ns;    // start of the current session
+    uint64_t samples;       // per receiver, sent in the current session
+    double rate_session;    // achieved since the session started
+    double rate_now;        // achieved over the last second or so
+    uint64_t missed;        // batches sent more than a batch period late
+    uint64_t resyncs;       // pacing restarted from now instead of catching up
+    uint64_t skipped_ns;    // time given up by resyncs
+    uint64_t late_max_ns;
+} hpsdr_ep6_stats_t;
+
+extern hpsdr_ep6_stats_t ep6_stats;
+
+     int ep6_init(void);
+    void ep6_deinit(void);
+    void ep6_request_start(void);
+    void ep6_request_stop(void);
+    bool ep6_active(void);
+     int ep6_start(void);
+    void ep6_stop(void);
+    void ep6_build(void);
+uint64_t ep6_deadline(void);
+    void ep6_late(uint64_t now);
+    void ep6_send(void);
+    void ep6_bench(void);
 
 #endif /* HPSDR_EP6_H_ */
@@ -0,0 +1,51 @@
+/*
+ * Copyright 2021 Emiliano Gonzalez LU3VEA (lu3vea @ gmail . com))
+ * * Project Site: https://github.com/hiperiondev/hpsdr-p1-rpitx *
+ *
+ * This is based on other projects:
+ *    librpitx (https://github.com/F5OEO/librpitx)
+ *    HPSDR simulator (https://github.com/g0orx/pihpsdr)
+ *    small-memory XML config database library (https://github.com/dleonard0/mxml)
+ *
+ *    please contact their authors for more information.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ *
+ */
+
+#ifndef HPSDR_FLOW_H_
+#define HPSDR_FLOW_H_
+
+#include <stdint.h>
+
+typedef struct hpsdr_flow_stats {
+    double ppm;          // ep6 rate offset applied, + sends faster
+    double drift;        // its integral part, ppm: the host/dma rate offset the loop has found
+    double fill;         // tx ring fill, averaged over the last period
+    double setpoint;     // fill level the loop steers to, samples
+    double error;        // fill - setpoint
+    uint64_t updates;
+    uint64_t locks;      // loop (re)starts
+    uint64_t clamped;    // updates at the ppm limit
+} hpsdr_flow_stats_t;
+
+extern hpsdr_flow_stats_t flow_stats;
+
+  void hpsdr_flow_reset(void);
+  void hpsdr_flow_sample(uint32_t fill);
+   int hpsdr_flow_update(uint64_t now);
+
+#endif /* HPSDR_FLOW_H_ */
@@ -0,0 +1,56 @@
+/*
+ * Copyright 2021 Emiliano Gonzalez LU3VEA (lu3vea @ gmail . com))
+ * * Project Site: https://github.com/hiperiondev/hpsdr-p1-rpitx *
+ *
+ * This is based on other projects:
+ *    librpitx (https://github.com/F5OEO/librpitx)
+ *    HPSDR simulator (https://github.com/g0orx/pihpsdr)
+ *    small-memory XML config database library (https://github.com/dleonard0/mxml)
+ *
+ *    please contact their authors for more information.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ *
+ */
+
+#ifndef HPSDR_INTERP_H_
+#define HPSDR_INTERP_H_
+
+#include <stdint.h>
+#include <complex.h>
+
+#define INTERP_MAX_FACTOR 8
+
+// polyphase fir interpolator for blocks of complex samples
+typedef struct hpsdr_interp {
+    unsigned factor;       // output samples per input sample
+    unsigned taps;         // taps per phase
+    unsigned block;        // input samples per run
+    float *coef;           // [phase][tap], tap 0 applies to the newest sample
+    float _Complex *hist;  // taps - 1 samples of history followed by the block
+    float *acc;            // one phase of output, interleaved I/Q
+    // statistics
+    uint64_t runs;
+    uint64_t busy_ns;
+    uint64_t busy_max_ns;
+} hpsdr_interp_t;
+
+ int hpsdr_interp_init(hpsdr_interp_t *f, unsigned factor, unsigned taps, unsigned block);
+void hpsdr_interp_deinit(hpsdr_interp_t *f);
+void hpsdr_interp_run(hpsdr_interp_t *f, const float _Complex *in, float _Complex *out);
+void hpsdr_interp_bench(unsigned taps, unsigned block);
+
+#endif /* HPSDR_INTERP_H_ */
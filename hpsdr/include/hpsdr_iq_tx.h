@@ -30,11 +30,43 @@
 #define HPSDR_IQ_TX_H_
 
 #include <stdint.h>
+#include <stdbool.h>
+#include <complex.h>
 
-void iqsender_deinit(void);
-void iqsender_init(uint64_t TuneFrequency);
-void iqsender_set(void);
-void iqsender_clear_buffer(void);
-void *iqsender_tx(void *data);
+#include "hpsdr_ring.h"
+#include "hpsdr_interp.h"
+
+typedef struct hpsdr_tx_stats {
+    uint64_t fast_retunes;    // moved inside the retune window, dma kept running
+    uint64_t backend_retunes; // carrier moved by the dma backend in place
+    uint64_t full_retunes;    // dma torn down and initialised on the new carrier
+    uint64_t in_convert_ns;   // samples_rcv: packet to ring format
+    uint64_t in_samples;
+    uint64_t out_convert_ns;  // feeder: compact ring to the float dma block
+    uint64_t out_samples;
+    uint64_t underruns;       // times the ring had no block when the dma needed one
+    uint64_t concealed;       // samples of fade out and silence fed instead
+    uint64_t recovered;       // partial blocks played out on entering an underrun, samples
+    uint64_t wakeups;         // feeder thread sleeps that ended
+    uint64_t idle_wakeups;    // of them while there was no tx
+    uint64_t cpu_ns;          // feeder thread cpu time
+} hpsdr_tx_stats_t;
+
+extern hpsdr_ring_t iq_ring;
+extern hpsdr_interp_t tx_interp;
+extern hpsdr_tx_stats_t tx_stats;
+
+     int iqsender_buffer_init(void);
+    void iqsender_write(const float _Complex *samples, unsigned len);
+    void iqsender_write16(const int16_t *samples, unsigned len);
+    void iqsender_deinit(void);
+    void iqsender_init(uint64_t TuneFrequency);
+    void iqsender_set(void);
+    void iqsender_clear_buffer(void);
+    long iqsender_block_time(void);
+unsigned iqsender_tx_want(void);
+     int iqsender_tx_timeout(void);
+    bool iqsender_tx_block(void);
+   void *iqsender_tx(void *data);
 
 #endif /* HPSDR_IQ_TX_H_ */
@@ -0,0 +1,56 @@
+/*
+ * Copyright 2021 Emiliano Gonzalez LU3VEA (lu3vea @ gmail . com))
+ * * Project Site: https://github.com/hiperiondev/hpsdr-p1-rpitx *
+ *
+ * This is based on other projects:
+ *    librpitx (https://github.com/F5OEO/librpitx)
+ *    HPSDR simulator (https://github.com/g0orx/pihpsdr)
+ *    small-memory XML config database library (https://github.com/dleonard0/mxml)
+ *
+ *    please contact their authors for more information.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ *
+ */
+
+#ifndef HPSDR_JITTER_H_
+#define HPSDR_JITTER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define JITTER_BINS    256  // 1 ms lateness histogram bins
+#define JITTER_GROW_MS 5    // floor raised on every underrun
+#define JITTER_SHRINK  48   // samples (1 ms) dropped per clean window at most
+
+typedef struct hpsdr_jitter_stats {
+    uint32_t jitter_ms;   // configured percentile of ep2 arrival lateness
+    uint32_t floor_ms;    // raised by underruns, decays on clean windows
+    uint32_t target;      // samples wanted in the tx ring ahead of a block
+    uint64_t underruns;   // blocks that found the ring short
+    uint64_t trimmed;     // samples dropped to shrink the buffer
+    uint64_t resyncs;     // arrival clock restarts (stream gaps)
+} hpsdr_jitter_stats_t;
+
+extern hpsdr_jitter_stats_t jitter_stats;
+
+    void hpsdr_jitter_init(unsigned block, unsigned capacity);
+    void hpsdr_jitter_arrival(uint64_t now, unsigned samples);
+unsigned hpsdr_jitter_target(void);
+    void hpsdr_jitter_underrun(void);
+unsigned hpsdr_jitter_fill(unsigned fill, bool trim_ok);
+
+#endif /* HPSDR_JITTER_H_ */
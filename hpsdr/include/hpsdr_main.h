@@ -47,8 +47,48 @@ typedef struct global {
     bool debug;
     int iqburst;
     emulation_type_t emulation;
+    int rxbatch;
+    bool rxgro;
+    int txbatch;
+    bool txgso;
+    int statsinterval;
+    net_backend_t netbackend;
+    int pktpool;
+    run_mode_t runmode;
+    int reorder;  // ep2 frames held back to restore sequence order, 0: release at once
+    catchup_t catchup;  // late ep6 batches: sent back to back (burst) or dropped (skip)
+    bool flowcontrol;   // nudge the ep6 rate to hold the tx ring fill
+    int flowppm;        // flow control offset limit
+    bool bench;         // time the hot paths at startup
 } global_t;
 
+typedef struct pipeline {
+    bool enabled;
+    int queue;
+    int cpu[4];  // per stage (hpsdr_stage_id_t), -1: not pinned
+} pipeline_t;
+
+typedef struct tx {
+    int retunewindow;  // Hz around the dma carrier retuned in place, 0: always reinit
+    bool compact;      // keep the tx ring in 16 bit I/Q, converted to float per dma block
+    bool jitterbuffer; // size the tx fill level from the measured ep2 arrival jitter
+    int jitterpercentile;
+    int jittermax;     // ms of jitter allowance at most
+    bool resample;     // steer the tx ring fill by resampling against host/dma clock drift
+    int interpolation; // dma runs at 48 kHz times this (1, 2, 4, 8)
+    int taps;          // interpolation filter taps per phase
+    dma_backend_t dma;
+    char *dmafile;     // virtual dma: write the samples here (cf32), NULL for none
+    int dmappm;        // virtual dma: clock offset against the host clock
+} tx_t;
+
+typedef struct rx {
+    rx_source_type_t source;  // ep6 receiver samples, none: silence
+    char *file;               // file source: recording to play (raw or wav)
+    rx_format_t format;       // raw recordings
+    int channels;             // raw recordings, interleaved I/Q pairs
+} rx_t;
+
 typedef struct filters {
     bool enabled;
     int delay;
@@ -65,6 +105,9 @@ typedef struct band {
 
 typedef struct hpsdr_config {
     global_t global;
+    pipeline_t pipeline;
+    tx_t tx;
+    rx_t rx;
     filters_t filters;
     band_t bands[MAXBANDS];
     int bands_len;
@@ -73,8 +116,6 @@ typedef struct hpsdr_config {
 extern hpsdr_config_t config;
 
 iqdmasync_t *iqsender;
-extern int enable_thread;
-extern int active_thread;
 extern int device_emulation;
 
 // RTXLEN must be an sixteen-fold multiple of 63
@@ -82,15 +123,14 @@ extern int device_emulation;
 // and two METIS packets per TCP/UDP packet,
 // and two/four/eight-fold up-sampling if the TX sample
 // rate is 96000/192000/384000
-#define TXLEN 10 // tx buffer len = TXLEN * iqburst
+#define TXLEN 10 // tx ring len = TXLEN * iqburst (rounded up to a power of two)
 
-extern      int tx_iq_ptr;
 extern     bool tx_init;
 extern uint32_t last_seqnum;
 extern uint32_t seqnum;
 
 typedef struct tx_args_st {
-    float _Complex *iq_buffer;
+    float _Complex *iq_buffer;  // one block (iqburst samples) on its way to the dma
     iqdmasync_t *iqsender;
 } tx_args_t;
 tx_args_t tx_arg;
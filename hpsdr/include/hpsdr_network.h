@@ -29,9 +29,26 @@
 #ifndef HPSDR_NETWORK_H_
 #define HPSDR_NETWORK_H_
 
+#include <stdint.h>
+#include <stddef.h>
+#include <netinet/in.h>
+
+typedef struct hpsdr_network_stats {
+    uint64_t rx_frames;    // datagrams dispatched
+    uint64_t rx_syscalls;  // successful receive calls
+    uint64_t tx_frames;    // ep6 frames sent
+    uint64_t tx_syscalls;  // send calls used for them
+    uint64_t tx_errors;    // failed send calls
+    uint64_t wakeups;      // event loop wakeups
+} hpsdr_network_stats_t;
+
+extern hpsdr_network_stats_t net_stats;
+
  int hpsdr_network_init(void);
 void hpsdr_network_deinit(void);
  int hpsdr_network_process(void);
+void hpsdr_network_reply(const uint8_t *buffer, size_t len, const struct sockaddr_in *to);
 void hpsdr_network_send(uint8_t *buffer, size_t len);
+void hpsdr_network_send_batch(uint8_t *frames, int count);
 
 #endif /* HPSDR_NETWORK_H_ */
@@ -0,0 +1,51 @@
+/*
+ * Copyright 2021 Emiliano Gonzalez LU3VEA (lu3vea @ gmail . com))
+ * * Project Site: https://github.com/hiperiondev/hpsdr-p1-rpitx *
+ *
+ * This is based on other projects:
+ *    librpitx (https://github.com/F5OEO/librpitx)
+ *    HPSDR simulator (https://github.com/g0orx/pihpsdr)
+ *    small-memory XML config database library (https://github.com/dleonard0/mxml)
+ *
+ *    please contact their authors for more information.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ *
+ */
+
+#ifndef HPSDR_PACK_H_
+#define HPSDR_PACK_H_
+
+#include <stdint.h>
+
+// largest sample of the 24 bit ep6 receiver streams, float samples are scaled by this
+#define PACK_SCALE 8388607.0f
+
+// src[k] holds the I/Q pairs of receiver k, sample j at src[k] + j * stride, dst is a 504-byte block;
+// the s16 and s24 variants take little endian recordings and stride in bytes
+         int hpsdr_pack_init(void);
+const char* hpsdr_pack_kernel(void);
+        void hpsdr_pack_bench(void);
+        void hpsdr_pack_s32_scalar(uint8_t *dst, const int32_t *const *src, unsigned stride, int receivers, int n);
+        void hpsdr_pack_s32(uint8_t *dst, const int32_t *const *src, unsigned stride, int receivers, int n);
+        void hpsdr_pack_f32_scalar(uint8_t *dst, const float *const *src, unsigned stride, int receivers, int n);
+        void hpsdr_pack_f32(uint8_t *dst, const float *const *src, unsigned stride, int receivers, int n);
+        void hpsdr_pack_s16_scalar(uint8_t *dst, const uint8_t *const *src, unsigned stride, int receivers, int n);
+        void hpsdr_pack_s16(uint8_t *dst, const uint8_t *const *src, unsigned stride, int receivers, int n);
+        void hpsdr_pack_s24_scalar(uint8_t *dst, const uint8_t *const *src, unsigned stride, int receivers, int n);
+        void hpsdr_pack_s24(uint8_t *dst, const uint8_t *const *src, unsigned stride, int receivers, int n);
+
+#endif /* HPSDR_PACK_H_ */
@@ -0,0 +1,79 @@
+/*
+ * Copyright 2021 Emiliano Gonzalez LU3VEA (lu3vea @ gmail . com))
+ * * Project Site: https://github.com/hiperiondev/hpsdr-p1-rpitx *
+ *
+ * This is based on other projects:
+ *    librpitx (https://github.com/F5OEO/librpitx)
+ *    HPSDR simulator (https://github.com/g0orx/pihpsdr)
+ *    small-memory XML config database library (https://github.com/dleonard0/mxml)
+ *
+ *    please contact their authors for more information.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ *
+ */
+
+#ifndef HPSDR_PIPELINE_H_
+#define HPSDR_PIPELINE_H_
+
+#include <stdint.h>
+
+#include "hpsdr_pool.h"
+#include "hpsdr_queue.h"
+
+typedef enum {
+    STAGE_NET,    // network receive and dispatch (main thread)
+    STAGE_DECODE, // c&c and tx sample decode of ep2 frames
+    STAGE_TX,     // dma feeder (iqsender_tx)
+    STAGE_EP6,    // ep6 frame generation and send
+    STAGE_MAX     //
+} hpsdr_stage_id_t;
+
+// written only by the stage's own thread
+typedef struct hpsdr_stage {
+    const char *name;
+    uint64_t items;        // packets, blocks or frames processed
+    uint64_t busy_ns;      // time spent processing them
+    uint64_t busy_max_ns;  // longest single run
+} hpsdr_stage_t;
+
+#define REORDER_MAX    32   // config.global.reorder limit
+#define REORDER_SLOTS  64   // power of two above REORDER_MAX
+#define REORDER_RESYNC 256  // a sequence jump this far is a new stream, not loss
+
+typedef struct hpsdr_reorder_stats {
+    uint64_t reordered;   // frames that arrived after a later one
+    uint64_t duplicated;  // copies of a frame already held or released
+    uint64_t late;        // frames that arrived after they were concealed
+    uint64_t lost;        // frames concealed
+    uint64_t resyncs;     // sequence jumps handled as a new stream
+    uint32_t held_max;    // most frames waiting in the window at once
+} hpsdr_reorder_stats_t;
+
+extern hpsdr_stage_t stages[STAGE_MAX];
+extern hpsdr_reorder_stats_t reorder_stats;
+extern hpsdr_queue_t decode_queue;
+
+     int hpsdr_pipeline_init(void);
+    void hpsdr_pipeline_deinit(void);
+    void hpsdr_pipeline_pin(hpsdr_stage_id_t id);
+uint64_t hpsdr_pipeline_now(void);
+    void hpsdr_pipeline_account(hpsdr_stage_id_t id, uint64_t start, unsigned items);
+    void hpsdr_pipeline_seq_reset(void);
+    void hpsdr_pipeline_ep2(const hpsdr_pkt_t *pkt);
+    void hpsdr_pipeline_print(void);
+
+#endif /* HPSDR_PIPELINE_H_ */
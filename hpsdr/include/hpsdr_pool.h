@@ -0,0 +1,69 @@
+/*
+ * Copyright 2021 Emiliano Gonzalez LU3VEA (lu3vea @ gmail . com))
+ * * Project Site: https://github.com/hiperiondev/hpsdr-p1-rpitx *
+ *
+ * This is based on other projects:
+ *    librpitx (https://github.com/F5OEO/librpitx)
+ *    HPSDR simulator (https://github.com/g0orx/pihpsdr)
+ *    small-memory XML config database library (https://github.com/dleonard0/mxml)
+ *
+ *    please contact their authors for more information.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ *
+ */
+
+#ifndef HPSDR_POOL_H_
+#define HPSDR_POOL_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#define POOL_ALIGN 64  // cache line
+
+// a received packet: a reference to (part of) a pool slot
+typedef struct hpsdr_pkt {
+     int slot;
+    uint32_t off;
+    uint32_t len;
+} hpsdr_pkt_t;
+
+typedef struct hpsdr_pool_stats {
+    uint64_t gets;       // slots handed out
+    uint64_t exhausted;  // requests that found the pool empty
+    uint32_t in_use;     // slots currently referenced
+    uint32_t in_use_max; // high-water mark
+} hpsdr_pool_stats_t;
+
+extern hpsdr_pool_stats_t pool_stats;
+
+     int hpsdr_pool_init(unsigned slots, size_t slot_size);
+    void hpsdr_pool_deinit(void);
+  size_t hpsdr_pool_slot_size(void);
+unsigned hpsdr_pool_slots(void);
+     int hpsdr_pool_event_fd(void);
+    bool hpsdr_pool_wait(void);
+     int hpsdr_pool_get(void);
+    void hpsdr_pool_ref(int slot);
+    void hpsdr_pool_put(int slot);
+uint8_t* hpsdr_pool_data(int slot);
+
+static inline uint8_t* hpsdr_pkt_data(const hpsdr_pkt_t *pkt) {
+    return hpsdr_pool_data(pkt->slot) + pkt->off;
+}
+
+#endif /* HPSDR_POOL_H_ */
@@ -0,0 +1,61 @@
+/*
+ * Copyright 2021 Emiliano Gonzalez LU3VEA (lu3vea @ gmail . com))
+ * * Project Site: https://github.com/hiperiondev/hpsdr-p1-rpitx *
+ *
+ * This is based on other projects:
+ *    librpitx (https://github.com/F5OEO/librpitx)
+ *    HPSDR simulator (https://github.com/g0orx/pihpsdr)
+ *    small-memory XML config database library (https://github.com/dleonard0/mxml)
+ *
+ *    please contact their authors for more information.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ *
+ */
+
+#ifndef HPSDR_QUEUE_H_
+#define HPSDR_QUEUE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#define QUEUE_ALIGN 64  // cache line
+
+// bounded single-producer/single-consumer queue of fixed size elements
+typedef struct hpsdr_queue {
+    // producer side
+    uint32_t tail __attribute__((aligned(QUEUE_ALIGN)));
+    uint32_t depth_max;  // high-water mark
+    uint64_t drops;      // pushes that found the queue full
+    // consumer side
+    uint32_t head __attribute__((aligned(QUEUE_ALIGN)));
+    uint32_t sleeping;   // consumer is (about to be) waiting on tail
+    // read only after init
+    uint8_t *data __attribute__((aligned(QUEUE_ALIGN)));
+    uint32_t mask;
+    size_t elem;
+} hpsdr_queue_t;
+
+     int hpsdr_queue_init(hpsdr_queue_t *q, unsigned capacity, size_t elem);
+    void hpsdr_queue_deinit(hpsdr_queue_t *q);
+    bool hpsdr_queue_push(hpsdr_queue_t *q, const void *item);
+    bool hpsdr_queue_pop(hpsdr_queue_t *q, void *item);
+    bool hpsdr_queue_wait(hpsdr_queue_t *q, int timeout_ms);
+    void hpsdr_queue_wake(hpsdr_queue_t *q);
+uint32_t hpsdr_queue_depth(hpsdr_queue_t *q);
+
+#endif /* HPSDR_QUEUE_H_ */
@@ -0,0 +1,56 @@
+/*
+ * Copyright 2021 Emiliano Gonzalez LU3VEA (lu3vea @ gmail . com))
+ * * Project Site: https://github.com/hiperiondev/hpsdr-p1-rpitx *
+ *
+ * This is based on other projects:
+ *    librpitx (https://github.com/F5OEO/librpitx)
+ *    HPSDR simulator (https://github.com/g0orx/pihpsdr)
+ *    small-memory XML config database library (https://github.com/dleonard0/mxml)
+ *
+ *    please contact their authors for more information.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ *
+ */
+
+#ifndef HPSDR_RESAMPLE_H_
+#define HPSDR_RESAMPLE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <complex.h>
+
+#define RESAMPLE_MAX_PPM 1000  // correction clamp
+
+// extra input samples a block of n outputs may need at the correction clamp
+#define RESAMPLE_SLACK(n) (((uint64_t) (n) * RESAMPLE_MAX_PPM + 999999) / 1000000 + 2)
+
+typedef struct hpsdr_resample_stats {
+    double ppm;          // estimated host clock offset against the dma clock
+    double correction;   // ppm applied to the last block
+    double setpoint;     // fill level the loop steers to, samples
+    uint64_t locks;      // loop (re)starts
+    uint64_t clamped;    // blocks at the correction limit
+} hpsdr_resample_stats_t;
+
+extern hpsdr_resample_stats_t resample_stats;
+
+    void hpsdr_resample_reset(void);
+unsigned hpsdr_resample_need(unsigned n);
+    void hpsdr_resample_run(const float _Complex *in, float _Complex *out, unsigned n);
+    void hpsdr_resample_control(unsigned fill, unsigned setpoint, unsigned n);
+
+#endif /* HPSDR_RESAMPLE_H_ */
@@ -0,0 +1,65 @@
+/*
+ * Copyright 2021 Emiliano Gonzalez LU3VEA (lu3vea @ gmail . com))
+ * * Project Site: https://github.com/hiperiondev/hpsdr-p1-rpitx *
+ *
+ * This is based on other projects:
+ *    librpitx (https://github.com/F5OEO/librpitx)
+ *    HPSDR simulator (https://github.com/g0orx/pihpsdr)
+ *    small-memory XML config database library (https://github.com/dleonard0/mxml)
+ *
+ *    please contact their authors for more information.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ *
+ */
+
+#ifndef HPSDR_RING_H_
+#define HPSDR_RING_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#define RING_ALIGN 64  // cache line
+
+// single-producer/single-consumer ring of samples, read and written in runs
+typedef struct hpsdr_ring {
+    // producer side
+    uint32_t tail __attribute__((aligned(RING_ALIGN)));
+    uint32_t fill_max;   // high-water mark
+    uint64_t overruns;   // samples dropped because the ring was full
+    // consumer side
+    uint32_t head __attribute__((aligned(RING_ALIGN)));
+    uint32_t want;       // consumer is (about to be) waiting for this fill level, 0: not waiting
+    // read only after init
+    uint8_t *data __attribute__((aligned(RING_ALIGN)));
+    uint32_t size;
+    uint32_t mask;
+    size_t elem;
+} hpsdr_ring_t;
+
+     int hpsdr_ring_init(hpsdr_ring_t *r, unsigned capacity, size_t elem);
+    void hpsdr_ring_deinit(hpsdr_ring_t *r);
+unsigned hpsdr_ring_write(hpsdr_ring_t *r, const void *src, unsigned n);
+unsigned hpsdr_ring_read(hpsdr_ring_t *r, void *dst, unsigned n);
+    void hpsdr_ring_skip(hpsdr_ring_t *r, unsigned n);
+    void hpsdr_ring_discard(hpsdr_ring_t *r);
+    bool hpsdr_ring_wait(hpsdr_ring_t *r, unsigned n, int timeout_ms);
+    void hpsdr_ring_wake(hpsdr_ring_t *r);
+uint32_t hpsdr_ring_fill(hpsdr_ring_t *r);
+uint32_t hpsdr_ring_space(hpsdr_ring_t *r);
+
+#endif /* HPSDR_RING_H_ */
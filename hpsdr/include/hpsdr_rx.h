@@ -0,0 +1,74 @@
+/*
+ * Copyright 2021 Emiliano Gonzalez LU3VEA (lu3vea @ gmail . com))
+ * * Project Site: https://github.com/hiperiondev/hpsdr-p1-rpitx *
+ *
+ * This is based on other projects:
+ *    librpitx (https://github.com/F5OEO/librpitx)
+ *    HPSDR simulator (https://github.com/g0orx/pihpsdr)
+ *    small-memory XML config database library (https://github.com/dleonard0/mxml)
+ *
+ *    please contact their authors for more information.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ *
+ */
+
+#ifndef HPSDR_RX_H_
+#define HPSDR_RX_H_
+
+#include <stdint.h>
+
+#include "hpsdr_definitions.h"
+
+// frames (one sample for every channel) lying in one piece in the source's memory
+typedef struct hpsdr_rx_span {
+    const uint8_t *data;
+    unsigned frames;
+} hpsdr_rx_span_t;
+
+// how the source lays out its frames, set by open
+typedef struct hpsdr_rx_layout {
+    rx_format_t format;
+    unsigned channels;  // I/Q pairs, receiver k plays pair k modulo channels / 2
+    unsigned stride;    // bytes per frame
+    unsigned rate;      // recorded rate if known, 0 otherwise
+} hpsdr_rx_layout_t;
+
+// where the ep6 receiver samples come from, NULL: silence
+typedef struct hpsdr_rx_source {
+    const char *name;
+     int (*open)(hpsdr_rx_layout_t *layout);
+    void (*peek)(hpsdr_rx_span_t *span, unsigned want);  // at least one frame, at most want
+    void (*consume)(unsigned frames);
+    void (*close)(void);
+} hpsdr_rx_source_t;
+
+typedef struct hpsdr_rx_stats {
+    uint64_t samples;  // per receiver
+    uint64_t loops;    // playback wrapped to the start
+} hpsdr_rx_stats_t;
+
+extern const hpsdr_rx_source_t *rx;
+extern const hpsdr_rx_source_t rx_file;
+extern hpsdr_rx_layout_t rx_layout;
+extern hpsdr_rx_stats_t rx_stats;
+
+ int hpsdr_rx_init(void);
+void hpsdr_rx_deinit(void);
+void hpsdr_rx_pack(uint8_t *pointer, unsigned n, int receivers);
+const char* hpsdr_rx_format(rx_format_t format);
+
+#endif /* HPSDR_RX_H_ */
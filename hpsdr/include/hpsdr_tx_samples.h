@@ -32,5 +32,6 @@
 #include <stdint.h>
 
 void samples_rcv(uint8_t *buffer);
+void samples_conceal(const uint8_t *next);
 
 #endif /* HPSDR_TX_SAMPLES_H_ */
@@ -0,0 +1,91 @@
+/*
+ * Copyright 2021 Emiliano Gonzalez LU3VEA (lu3vea @ gmail . com))
+ * * Project Site: https://github.com/hiperiondev/hpsdr-p1-rpitx *
+ *
+ * This is based on other projects:
+ *    librpitx (https://github.com/F5OEO/librpitx)
+ *    HPSDR simulator (https://github.com/g0orx/pihpsdr)
+ *    small-memory XML config database library (https://github.com/dleonard0/mxml)
+ *
+ *    please contact their authors for more information.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ *
+ */
+
+#ifndef HPSDR_URING_H_
+#define HPSDR_URING_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#if defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#endif
+#endif
+
+// multishot recvmsg and provided buffer rings came with linux 6.0 headers
+#if defined(IORING_RECV_MULTISHOT)
+#define HPSDR_HAVE_URING 1
+#else
+#define HPSDR_HAVE_URING 0
+struct io_uring_sqe;
+struct io_uring_cqe;
+struct io_uring_buf_ring;
+#endif
+
+// minimal io_uring instance over the raw system calls
+typedef struct hpsdr_uring {
+    int fd;
+    // submission queue
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_array;
+    unsigned sq_mask;
+    unsigned sq_entries;
+    unsigned sq_local_tail;
+    unsigned to_submit;
+    struct io_uring_sqe *sqes;
+    // completion queue
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned cq_mask;
+    struct io_uring_cqe *cqes;
+    // provided buffer ring (one buffer group per instance)
+    struct io_uring_buf_ring *br;
+    unsigned br_mask;
+    unsigned br_tail;
+    // mappings
+    void *sq_ptr;
+    void *cq_ptr;
+    size_t sq_len;
+    size_t cq_len;
+    size_t sqes_len;
+    size_t br_len;
+} hpsdr_uring_t;
+
+                int hpsdr_uring_init(hpsdr_uring_t *ring, unsigned entries, unsigned cq_entries);
+               void hpsdr_uring_deinit(hpsdr_uring_t *ring);
+struct io_uring_sqe* hpsdr_uring_get_sqe(hpsdr_uring_t *ring);
+                int hpsdr_uring_submit(hpsdr_uring_t *ring, unsigned wait_nr);
+struct io_uring_cqe* hpsdr_uring_peek_cqe(hpsdr_uring_t *ring);
+               void hpsdr_uring_cqe_seen(hpsdr_uring_t *ring);
+                int hpsdr_uring_pbuf_init(hpsdr_uring_t *ring, uint16_t bgid, unsigned entries);
+               void hpsdr_uring_pbuf_add(hpsdr_uring_t *ring, void *addr, unsigned len, uint16_t bid);
+               void hpsdr_uring_pbuf_advance(hpsdr_uring_t *ring);
+
+#endif /* HPSDR_URING_H_ */